@@ -0,0 +1,94 @@
+#define MISC_IMPL
+#include "../misc.h"
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+// Allocation scaling from 1 thread until every core is busy.
+
+#define ALLOCS_PER_THREAD (1 << 22)
+
+typedef enum {
+    LOCKED,
+    SHARED,
+    LOCAL,
+} Mode;
+
+static const char* modeName[] = {
+    [LOCKED] = "mutex + arena",
+    [SHARED] = "shared arena",
+    [LOCAL]  = "threadArena()",
+};
+
+static Mode mode;
+static Arena* arena;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static f64 now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+
+static void* worker(void* arg)
+{
+    (void)arg;
+    usize sum = 0;
+
+    for (usize i = 0; i < ALLOCS_PER_THREAD; i++) {
+        usize size = 8 + (i & 63);
+        u8* p = NULL;
+
+        switch (mode) {
+        case LOCKED:
+            pthread_mutex_lock(&mutex);
+            p = allocArena(arena, size);
+            pthread_mutex_unlock(&mutex);
+            break;
+
+        case SHARED:
+            p = allocArena(arena, size);
+            break;
+
+        case LOCAL:
+            p = allocArena(threadArena(), size);
+            break;
+        }
+
+        *p = (u8)i;
+        sum += *p;
+    }
+
+    if (mode == LOCAL) freeThreadArena();
+    return (void*)sum;
+}
+
+int main(void)
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores < 1) cores = 1;
+
+    pthread_t* threads = strictAlloc((usize)cores * sizeof *threads);
+    printfn("%-16s %8s %12s %14s", "mode", "threads", "seconds", "Mallocs/sec");
+
+    for (mode = LOCKED; mode <= LOCAL; mode++) {
+        for (long n = 1; n <= cores; n = n < cores && n * 2 > cores ? cores : n * 2) {
+            arena = mode == SHARED ? initArenaShared(1 << 20) : initArena(1 << 20);
+
+            f64 start = now();
+            for (long i = 0; i < n; i++)
+                pthread_create(&threads[i], NULL, worker, NULL);
+            for (long i = 0; i < n; i++)
+                pthread_join(threads[i], NULL);
+            f64 elapsed = now() - start;
+
+            printfn("%-16s %8ld %12.4f %14.2f",
+                    modeName[mode], n, elapsed,
+                    (f64)n * ALLOCS_PER_THREAD / elapsed / 1e6);
+            freeArena(arena);
+        }
+    }
+
+    free(threads);
+}
@@ -0,0 +1,66 @@
+#define MISC_IMPL
+#include "../misc.h"
+#include <time.h>
+
+// Append throughput of Array(T) for several item sizes.
+
+#define ITEMS (1 << 20)
+
+typedef struct { u8 bytes[16]; } Item16;
+typedef struct { u8 bytes[64]; } Item64;
+
+static f64 now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+
+static void report(const char* name, usize size, f64 elapsed)
+{
+    printfn("%-10s %6zu %12.4f %14.2f", name, size, elapsed, ITEMS / elapsed / 1e6);
+}
+
+/*
+constant: the old policy, the capacity grows by MISC_ARRAY_RESERVE.
+geometric: appendArray() with the default policy.
+reserved: reserveArray() once, then appendArray().
+*/
+#define benchAppend(T)                                                      \
+    do {                                                                    \
+        T item = {0};                                                       \
+        f64 start = now();                                                  \
+        Array(T) constant = {0};                                            \
+        for (usize i = 0; i < ITEMS; i++) {                                 \
+            if (constant.cap <= constant.len)                               \
+                resizeArray(&constant, constant.cap + MISC_ARRAY_RESERVE);  \
+            constant.items[constant.len++] = item;                          \
+        }                                                                   \
+        report("constant", sizeof(T), now() - start);                       \
+        freeArray(&constant);                                               \
+                                                                            \
+        start = now();                                                      \
+        Array(T) geometric = {0};                                           \
+        for (usize i = 0; i < ITEMS; i++)                                   \
+            appendArray(&geometric, item);                                  \
+        report("geometric", sizeof(T), now() - start);                      \
+        freeArray(&geometric);                                              \
+                                                                            \
+        start = now();                                                      \
+        Array(T) reserved = {0};                                            \
+        reserveArray(&reserved, ITEMS);                                     \
+        for (usize i = 0; i < ITEMS; i++)                                   \
+            appendArray(&reserved, item);                                   \
+        report("reserved", sizeof(T), now() - start);                       \
+        freeArray(&reserved);                                               \
+    } while (0)
+
+int main(void)
+{
+    printfn("%-10s %6s %12s %14s", "policy", "bytes", "seconds", "Mappends/sec");
+    benchAppend(u8);
+    benchAppend(u32);
+    benchAppend(u64);
+    benchAppend(Item16);
+    benchAppend(Item64);
+}
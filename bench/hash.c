@@ -0,0 +1,120 @@
+#define MISC_IMPL
+#include "../misc.h"
+#include <time.h>
+
+// initFNV() against initWyhash(), throughput per key size and the Map probe lengths.
+
+#define BYTES (256 * 1024 * 1024)
+#define KEYS (1000 * 1000)
+
+static u64 state = 0x9e3779b97f4a7c15ULL;
+
+static u64 random64(void)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static f64 now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+
+static u64 hashFNV(const void* key, usize keyLen, u64 seed)
+{
+    (void)seed;
+    return initFNV(key, keyLen);
+}
+
+static void benchThroughput(const u8* bytes, usize keyLen)
+{
+    usize keys = BYTES / keyLen;
+    u64 sink = 0;
+
+    f64 start = now();
+    for (usize i = 0; i < keys; i++)
+        sink ^= initFNV(bytes + i * keyLen, keyLen);
+    f64 fnvTime = now() - start;
+
+    start = now();
+    for (usize i = 0; i < keys; i++)
+        sink ^= initWyhash(bytes + i * keyLen, keyLen, 0);
+    f64 wyTime = now() - start;
+
+    printfn("%6zu %10.2f %10.2f GB/s %s", keyLen,
+            BYTES / fnvTime / 1e9, BYTES / wyTime / 1e9, sink == 42 ? "!" : "");
+}
+
+// Average and longest distance from the home bucket, then the time to put and get every key.
+static void benchProbes(
+    const char* name,
+    u64       (*hash)(const void*, usize, u64),
+    const u64*  keys)
+{
+    Map map = { .hash = hash };
+
+    f64 start = now();
+    for (usize i = 0; i < KEYS; i++)
+        putInMap(&map, &keys[i], sizeof keys[i], &i, sizeof i);
+    f64 putTime = now() - start;
+
+    start = now();
+    usize found = 0;
+    for (usize i = 0; i < KEYS; i++)
+        found += getFromMap(&map, &keys[i], sizeof keys[i]) != NULL;
+    f64 getTime = now() - start;
+
+    usize total = 0, longest = 0;
+    for (usize i = 0; i < map.cap; i++) {
+        MapEntry* entry = &map.items[i];
+        if (entry->key == NULL) continue;
+
+        usize distance = (i - (entry->hash & (map.cap - 1))) & (map.cap - 1);
+        total += distance;
+        if (distance > longest) longest = distance;
+    }
+
+    miscAssert(found == KEYS, "every key should be found");
+    printfn("%-8s %10.2f %10zu %10.3f %10.3f", name, (f64)total / KEYS, longest, putTime, getTime);
+    freeMap(&map);
+}
+
+int main(void)
+{
+    u8* bytes = strictAlloc(BYTES);
+    for (usize i = 0; i < BYTES; i++)
+        bytes[i] = (u8)random64();
+
+    static const usize sizes[] = { 8, 16, 40, 100, 200, 1024 };
+    printfn("%6s %10s %10s", "key", "fnv", "wyhash");
+    for (usize i = 0; i < sizeof sizes / sizeof *sizes; i++)
+        benchThroughput(bytes, sizes[i]);
+    free(bytes);
+
+    u64* keys = strictAlloc(KEYS * sizeof *keys);
+    for (usize i = 0; i < KEYS; i++)
+        keys[i] = random64();
+
+    printfn("\n%-8s %10s %10s %10s %10s", "random", "avg probe", "max probe", "put", "get");
+    benchProbes("fnv", hashFNV, keys);
+    benchProbes("wyhash", NULL, keys);
+
+    /*
+    Keys whose bytes all have a zero low nibble, FNV only carries bits
+    upward, so the low bits that pick the bucket never change.
+    */
+    for (usize i = 0; i < KEYS; i++) {
+        keys[i] = 0;
+        for (usize b = 0; b < 8; b++)
+            keys[i] |= (u64)((i >> (b * 4)) & 0xf) << (b * 8 + 4);
+    }
+
+    printfn("\n%-8s %10s %10s %10s %10s", "nibbles", "avg probe", "max probe", "put", "get");
+    benchProbes("fnv", hashFNV, keys);
+    benchProbes("wyhash", NULL, keys);
+    free(keys);
+}
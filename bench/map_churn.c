@@ -0,0 +1,65 @@
+#define MISC_IMPL
+#include "../misc.h"
+#include <time.h>
+
+// Insert and delete churn on a fixed number of live keys, ns per operation over time.
+
+#define LIVE    (64 * 1024)
+#define ROUNDS  (8)
+#define PER_ROUND (4 * 1000 * 1000)
+
+static u64 state = 0x9e3779b97f4a7c15ULL;
+
+static u64 random64(void)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static f64 now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+
+static void benchChurn(const char* name, int flags)
+{
+    Map map = { .flags = flags };
+    u64* live = strictAlloc(LIVE * sizeof *live);
+    for (usize i = 0; i < LIVE; i++) {
+        live[i] = random64();
+        putInMap(&map, &live[i], sizeof live[i], &i, sizeof i);
+    }
+
+    printf("%-10s", name);
+    for (usize round = 0; round < ROUNDS; round++) {
+        f64 start = now();
+        for (usize i = 0; i < PER_ROUND; i++) {
+            usize at = random64() % LIVE;
+            deleteFromMap(&map, &live[at], sizeof live[at]);
+            live[at] = random64();
+            putInMap(&map, &live[at], sizeof live[at], &at, sizeof at);
+            miscAssert(getFromMap(&map, &live[(at * 7) % LIVE], sizeof live[at]) != NULL, "live key is missing");
+        }
+        printf(" %7.1f", (now() - start) * 1e9 / PER_ROUND);
+        fflush(stdout);
+    }
+    printfn(" (cap %zu)", map.cap);
+
+    freeMap(&map);
+    free(live);
+}
+
+int main(void)
+{
+    printf("%-10s", "ns/op");
+    for (usize round = 0; round < ROUNDS; round++)
+        printf(" %7zu", round + 1);
+    printf("\n");
+    benchChurn("linear", 0);
+    benchChurn("swiss", MISC_MAP_SWISS);
+    benchChurn("robinhood", MISC_MAP_ROBIN_HOOD);
+}
@@ -0,0 +1,72 @@
+#define MISC_IMPL
+#include "../misc.h"
+#include <time.h>
+
+// Linear probing against MISC_MAP_SWISS at load factors 0.5 and 0.875, u64 keys.
+
+#define CAPACITY ((usize)1 << 22)
+
+static u64 state = 0x9e3779b97f4a7c15ULL;
+
+static u64 random64(void)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static f64 now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+
+static void benchLayout(const char* name, int flags, f64 load, u64* keys, usize count)
+{
+    // Grows just past @load, so the table ends at CAPACITY filled to @load.
+    Map map = { .flags = flags, .maxLoad = load + 0.01 };
+
+    f64 start = now();
+    for (usize i = 0; i < count; i++)
+        putInMap(&map, &keys[i], sizeof keys[i], &i, sizeof i);
+    f64 putTime = now() - start;
+    miscAssert(map.cap == CAPACITY, "table should end at CAPACITY");
+
+    usize found = 0;
+    start = now();
+    for (usize i = 0; i < count; i++) {
+        usize* value = getFromMap(&map, &keys[i], sizeof keys[i]);
+        found += value != NULL && *value == i;
+    }
+    f64 hitTime = now() - start;
+
+    // Odd keys were inserted, even ones are never there.
+    start = now();
+    for (usize i = 0; i < count; i++) {
+        u64 miss = keys[i] ^ 1;
+        found -= getFromMap(&map, &miss, sizeof miss) != NULL;
+    }
+    f64 missTime = now() - start;
+
+    miscAssert(found == count, "every key should be found once");
+    printfn("%-6s %5.3f %10.3f %10.3f %10.3f", name, load, putTime, hitTime, missTime);
+    freeMap(&map);
+}
+
+int main(void)
+{
+    usize count = (usize)(CAPACITY * 0.875);
+    u64* keys = strictAlloc(count * sizeof *keys);
+    for (usize i = 0; i < count; i++)
+        keys[i] = random64() | 1;
+
+    printfn("%-6s %5s %10s %10s %10s", "layout", "load", "put", "hit", "miss");
+    for (f64 load = 0.5; load < 0.9; load += 0.375) {
+        usize used = (usize)(CAPACITY * load);
+        benchLayout("linear", 0, load, keys, used);
+        benchLayout("swiss", MISC_MAP_SWISS, load, keys, used);
+    }
+    free(keys);
+}
@@ -0,0 +1,57 @@
+#define MISC_IMPL
+#include "../misc.h"
+#include <time.h>
+
+// Map storage modes, time to put, get and free short (inline) and long keys,
+// with 8 byte values and 4 byte ones that don't fill an aligned pair.
+
+#define KEYS (4 * 1000 * 1000)
+
+static f64 now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+
+static void benchStorage(const char* name, int storage, usize keyLen, usize valueSize)
+{
+    Map map = { .storage = storage };
+    char key[64];
+    memset(key, '-', sizeof key);
+
+    f64 start = now();
+    for (usize i = 0; i < KEYS; i++) {
+        memcpy(key, &i, sizeof i);
+        putInMap(&map, key, keyLen, &i, valueSize);
+    }
+    f64 putTime = now() - start;
+
+    start = now();
+    usize found = 0;
+    for (usize i = 0; i < KEYS; i++) {
+        memcpy(key, &i, sizeof i);
+        void* value = getFromMap(&map, key, keyLen);
+        found += value != NULL && memcmp(value, &i, valueSize) == 0;
+    }
+    f64 getTime = now() - start;
+
+    start = now();
+    freeMap(&map);
+    f64 freeTime = now() - start;
+
+    miscAssert(found == KEYS, "every key should be found");
+    printfn("%-6s %4zu %5zu %10.3f %10.3f %10.3f", name, keyLen, valueSize, putTime, getTime, freeTime);
+}
+
+int main(void)
+{
+    printfn("%-6s %4s %5s %10s %10s %10s", "store", "key", "value", "put", "get", "free");
+    for (usize keyLen = 12; keyLen <= 48; keyLen += 36) {
+        for (usize valueSize = 8; valueSize >= 4; valueSize -= 4) {
+            benchStorage("heap", MISC_MAP_STORE_HEAP, keyLen, valueSize);
+            benchStorage("arena", MISC_MAP_STORE_ARENA, keyLen, valueSize);
+            benchStorage("slabs", MISC_MAP_STORE_SLABS, keyLen, valueSize);
+        }
+    }
+}
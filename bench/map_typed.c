@@ -0,0 +1,106 @@
+#define MISC_IMPL
+#include "../misc.h"
+#include <time.h>
+
+// DEFINE_MAP against the generic Map on u64 keys and values.
+
+#define KEYS (4 * 1000 * 1000)
+
+#define equalNumber(a, b) ((a) == (b))
+DEFINE_MAP(U64Map, u64, u64, hashU64, equalNumber)
+
+static u64 state = 0x9e3779b97f4a7c15ULL;
+
+static u64 random64(void)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static f64 now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+
+// Odd keys are inserted, even ones are only looked up.
+static void benchGeneric(const u64* keys)
+{
+    Map map = {0};
+    usize found = 0;
+
+    f64 start = now();
+    for (usize i = 0; i < KEYS; i++)
+        putInMap(&map, &keys[i], sizeof keys[i], &keys[i], sizeof keys[i]);
+    f64 putTime = now() - start;
+
+    start = now();
+    for (usize i = 0; i < KEYS; i++) {
+        u64* value = getFromMap(&map, &keys[i], sizeof keys[i]);
+        found += value != NULL && *value == keys[i];
+    }
+    f64 hitTime = now() - start;
+
+    start = now();
+    for (usize i = 0; i < KEYS; i++) {
+        u64 miss = keys[i] ^ 1;
+        found -= getFromMap(&map, &miss, sizeof miss) != NULL;
+    }
+    f64 missTime = now() - start;
+
+    start = now();
+    for (usize i = 0; i < KEYS; i++)
+        deleteFromMap(&map, &keys[i], sizeof keys[i]);
+    f64 deleteTime = now() - start;
+
+    miscAssert(found == KEYS && map.len == 0, "every key should be found once");
+    printfn("%-8s %10.3f %10.3f %10.3f %10.3f", "Map", putTime, hitTime, missTime, deleteTime);
+    freeMap(&map);
+}
+
+static void benchTyped(const u64* keys)
+{
+    U64Map map = {0};
+    usize found = 0;
+
+    f64 start = now();
+    for (usize i = 0; i < KEYS; i++)
+        putInU64Map(&map, keys[i], keys[i]);
+    f64 putTime = now() - start;
+
+    start = now();
+    for (usize i = 0; i < KEYS; i++) {
+        u64* value = getFromU64Map(&map, keys[i]);
+        found += value != NULL && *value == keys[i];
+    }
+    f64 hitTime = now() - start;
+
+    start = now();
+    for (usize i = 0; i < KEYS; i++)
+        found -= getFromU64Map(&map, keys[i] ^ 1) != NULL;
+    f64 missTime = now() - start;
+
+    start = now();
+    for (usize i = 0; i < KEYS; i++)
+        deleteFromU64Map(&map, keys[i]);
+    f64 deleteTime = now() - start;
+
+    miscAssert(found == KEYS && map.len == 0, "every key should be found once");
+    printfn("%-8s %10.3f %10.3f %10.3f %10.3f", "U64Map", putTime, hitTime, missTime, deleteTime);
+    freeU64Map(&map);
+}
+
+int main(void)
+{
+    u64* keys = strictAlloc(KEYS * sizeof *keys);
+    for (usize i = 0; i < KEYS; i++)
+        keys[i] = random64() | 1;
+
+    printfn("%-8s %10s %10s %10s %10s", "map", "put", "hit", "miss", "delete");
+    benchGeneric(keys);
+    benchTyped(keys);
+    free(keys);
+}
@@ -0,0 +1,109 @@
+#define MISC_IMPL
+#include "../misc.h"
+#include <time.h>
+
+// findSv() against a naive loop, and one MultiMatcher pass against findSv() per keyword.
+
+#define TEXT (64 * 1024 * 1024)
+#define KEYWORDS (200)
+
+static u64 state = 0x9e3779b97f4a7c15ULL;
+
+static u64 random64(void)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static f64 now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+
+static bool findNaive(StringView* sv, StringView* needle, usize* index)
+{
+    for (usize i = 0; i + needle->len <= sv->len; i++) {
+        if (memcmp(sv->items + i, needle->items, needle->len) == 0) {
+            *index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void benchFind(const char* name, StringView* text, StringView* needle)
+{
+    usize naive = 0, fast = 0;
+
+    f64 start = now();
+    bool found = findNaive(text, needle, &naive);
+    f64 naiveTime = now() - start;
+
+    start = now();
+    found = findSv(text, needle, &fast) && found;
+    f64 fastTime = now() - start;
+
+    miscAssert(naive == fast, "findSv() disagrees with the naive loop");
+    printfn("%-12s %10.3f %10.3f %s", name, naiveTime, fastTime, found ? "found" : "missing");
+}
+
+int main(void)
+{
+    char* bytes = strictAlloc(TEXT);
+    StringView text = { bytes, TEXT };
+
+    // Lowercase words over a small alphabet, like prose.
+    for (usize i = 0; i < TEXT; i++)
+        bytes[i] = random64() % 6 == 0 ? ' ' : (char)('a' + random64() % 16);
+
+    StringView needle = { "the keyword at the end", 22 };
+    memcpy(bytes + TEXT - needle.len, needle.items, needle.len);
+
+    printfn("%-12s %10s %10s", "needle", "naive", "findSv");
+    benchFind("text", &text, &needle);
+
+    // Every window starts and ends like the needle, the filter gives up for Two-Way.
+    memset(bytes, 'a', TEXT);
+    char worst[64];
+    memset(worst, 'a', sizeof worst);
+    worst[31] = 'b';
+    StringView adversarial = { worst, sizeof worst };
+    benchFind("adversarial", &text, &adversarial);
+
+    for (usize i = 0; i < TEXT; i++)
+        bytes[i] = random64() % 6 == 0 ? ' ' : (char)('a' + random64() % 16);
+
+    StringView keywords[KEYWORDS];
+    char store[KEYWORDS][8];
+    for (usize i = 0; i < KEYWORDS; i++) {
+        usize len = 4 + random64() % 4;
+        for (usize j = 0; j < len; j++)
+            store[i][j] = (char)('a' + random64() % 16);
+        keywords[i].items = store[i];
+        keywords[i].len = len;
+    }
+
+    f64 start = now();
+    usize each = 0;
+    for (usize i = 0; i < KEYWORDS; i++)
+        each += countSv(&text, &keywords[i]);
+    f64 eachTime = now() - start;
+
+    start = now();
+    MultiMatcher matcher = initMultiMatcher(keywords, KEYWORDS);
+    MultiMatch match = {0};
+    usize all = 0;
+    while (nextMultiMatch(&matcher, &text, &match))
+        all++;
+    f64 multiTime = now() - start;
+
+    printfn("%d keywords: countSv() each %.3f s (%zu), MultiMatcher %.3f s (%zu, overlapping)",
+            KEYWORDS, eachTime, each, multiTime, all);
+
+    freeMultiMatcher(&matcher);
+    free(bytes);
+}
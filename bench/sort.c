@@ -0,0 +1,93 @@
+#define MISC_IMPL
+#include "../misc.h"
+#include <time.h>
+
+// DEFINE_SORT and DEFINE_RADIX_SORT against qsort() on 10M items.
+
+#define ITEMS (10 * 1000 * 1000)
+
+#define lessNumber(a, b) ((a) < (b))
+DEFINE_SORT(I32, i32, lessNumber)
+DEFINE_SORT(U64, u64, lessNumber)
+DEFINE_SORT(F64, f64, lessNumber)
+DEFINE_RADIX_SORT(I32, i32, radixKeyI32)
+DEFINE_RADIX_SORT(U64, u64, radixKeyU64)
+DEFINE_RADIX_SORT(F64, f64, radixKeyF64)
+DEFINE_BOUNDS(U64, u64, lessNumber)
+
+#define compareNumber(T)                                \
+    static int compare##T(const void* a, const void* b) \
+    {                                                   \
+        T x = *(const T*)a, y = *(const T*)b;           \
+        return (x > y) - (x < y);                       \
+    }
+
+compareNumber(i32)
+compareNumber(u64)
+compareNumber(f64)
+
+static u64 state = 0x9e3779b97f4a7c15ULL;
+
+static u64 random64(void)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static f64 now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+
+#define benchSort(T, name, fill)                                                   \
+    do {                                                                           \
+        T* input = strictAlloc(ITEMS * sizeof(T));                                 \
+        T* work = strictAlloc(ITEMS * sizeof(T));                                  \
+        for (usize i = 0; i < ITEMS; i++)                                          \
+            input[i] = (fill);                                                     \
+                                                                                   \
+        memcpy(work, input, ITEMS * sizeof(T));                                    \
+        f64 start = now();                                                         \
+        qsort(work, ITEMS, sizeof(T), compare##T);                                 \
+        f64 qsortTime = now() - start;                                             \
+                                                                                   \
+        memcpy(work, input, ITEMS * sizeof(T));                                    \
+        start = now();                                                             \
+        sort##name(work, ITEMS);                                                   \
+        f64 introTime = now() - start;                                             \
+                                                                                   \
+        memcpy(work, input, ITEMS * sizeof(T));                                    \
+        start = now();                                                             \
+        radixSort##name(work, ITEMS);                                              \
+        f64 radixTime = now() - start;                                             \
+                                                                                   \
+        printfn("%-4s %10.3f %10.3f %10.3f", #T, qsortTime, introTime, radixTime); \
+        free(input);                                                               \
+        free(work);                                                                \
+    } while (0)
+
+int main(void)
+{
+    printfn("%-4s %10s %10s %10s", "type", "qsort", "sort", "radixSort");
+    benchSort(i32, I32, (i32)random64());
+    benchSort(u64, U64, random64());
+    benchSort(f64, F64, (f64)(i64)random64() / 1e9);
+
+    u64* sorted = strictAlloc(ITEMS * sizeof *sorted);
+    for (usize i = 0; i < ITEMS; i++)
+        sorted[i] = random64();
+    radixSortU64(sorted, ITEMS);
+
+    usize found = 0, queries = ITEMS / 10;
+    f64 start = now();
+    for (usize i = 0; i < queries; i++) {
+        u64 value = random64();
+        found += lowerBoundU64(sorted, ITEMS, value) < upperBoundU64(sorted, ITEMS, value);
+    }
+    printfn("%zu lower/upper bound pairs in %.3f seconds (%zu hits)", queries, now() - start, found);
+    free(sorted);
+}
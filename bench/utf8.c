@@ -0,0 +1,74 @@
+#define MISC_IMPL
+#include "../misc.h"
+#include <time.h>
+
+// isValidUtf8Sv() throughput on ASCII and mixed text, against memchr() as the memory bound.
+
+#define TEXT (256 * 1024 * 1024)
+
+static u64 state = 0x9e3779b97f4a7c15ULL;
+
+static u64 random64(void)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static f64 now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+
+static void benchText(const char* name, StringView* text)
+{
+    f64 start = now();
+    bool missing = memchr(text->items, 0xff, text->len) == NULL;
+    f64 memchrTime = now() - start;
+
+    start = now();
+    bool scalar = validateUtf8Scalar((const u8*)text->items, text->len);
+    f64 scalarTime = now() - start;
+
+    start = now();
+    bool valid = isValidUtf8Sv(text);
+    f64 validTime = now() - start;
+
+    start = now();
+    usize codepoints = countCodepointsSv(text);
+    f64 countTime = now() - start;
+
+    miscAssert(missing && valid && scalar, "the text should be valid");
+    f64 gb = (f64)text->len / 1e9;
+    printfn("%-6s %8.2f %8.2f %8.2f %8.2f GB/s (%zu codepoints)",
+            name, gb / memchrTime, gb / scalarTime, gb / validTime, gb / countTime, codepoints);
+}
+
+int main(void)
+{
+    char* bytes = strictAlloc(TEXT);
+    StringView text = { bytes, TEXT };
+
+    for (usize i = 0; i < TEXT; i++)
+        bytes[i] = (char)(' ' + random64() % 95);
+
+    printfn("%-6s %8s %8s %8s %8s", "text", "memchr", "scalar", "simd", "count");
+    benchText("ascii", &text);
+
+    // Mostly ASCII with two, three and four byte sequences mixed in.
+    static const char* mixed[] = { "e", "\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80", "word " };
+    usize len = 0;
+    while (len + 5 <= TEXT) {
+        const char* piece = mixed[random64() % 5];
+        usize n = strlen(piece);
+        memcpy(bytes + len, piece, n);
+        len += n;
+    }
+    text.len = len;
+    benchText("mixed", &text);
+
+    free(bytes);
+}
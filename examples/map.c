@@ -12,11 +12,12 @@ int main(int argc, const char **argv)
     }
 
     Map map = {0};
-    String buffer = readFileToString(argv[1]);
-    StringView curr, split = initSvFromString(&buffer, 0, buffer.len);
+    StringView buffer = mapFileToSv(argv[1], MISC_ADVISE_SEQUENTIAL);
+    StringView curr, split = buffer;
+    DelimSet spaces = initDelimSet(" \n");
     initMap(&map);
 
-    while (splitSvBy(&split, " \n", &curr)) {
+    while (splitSvBySet(&split, &spaces, &curr)) {
         usize *recv, count = 1;
 
         if ((recv = getFromMap(&map, curr.items, curr.len)) == NULL) {
@@ -34,6 +35,6 @@ int main(int argc, const char **argv)
                *(usize*)pair.value);
     }
 
-    freeArray(&buffer);
+    unmapSv(&buffer);
     freeMap(&map);
 }
@@ -0,0 +1,36 @@
+#define MISC_IMPL
+#include "../misc.h"
+
+// Parse numbers out of a line, then print them back in the shortest form.
+
+int main(void)
+{
+    char line[] = "42 -17 0.1 1e300 37.569930069930066 5e-324 nope";
+    StringView split = initSvFrom(line, 0, strlen(line));
+    StringView curr;
+    DelimSet spaces = initDelimSet(" ");
+    String out = {0};
+
+    while (splitSvBySet(&split, &spaces, &curr)) {
+        f64 value;
+        usize consumed;
+        if (parseF64FromSv(&curr, &value, &consumed) != MISC_PARSE_OK || consumed != curr.len) {
+            printfn("'%.*s' is not a number", stringFmt(curr));
+            continue;
+        }
+
+        char buf[MISC_NUMBER_CHARS];
+        usize len = formatF64(value, buf);
+        printfn("'%.*s' -> %.*s", stringFmt(curr), (int)len, buf);
+        appendF64ToString(&out, value);
+        appendCharToString(&out, ' ');
+    }
+
+    // More than 10 fractional digits, the last one is rounded to the nearest.
+    char buf[MISC_NUMBER_CHARS];
+    usize len = formatF64(37.569930069930066, buf);
+    miscAssert(len == 18 && memcmp(buf, "37.569930069930066", len) == 0, "shortest digits are not the nearest");
+
+    printfn("%.*s", stringFmt(out));
+    freeArray(&out);
+}
@@ -0,0 +1,51 @@
+#define MISC_IMPL
+#include "../misc.h"
+
+typedef struct {
+    i32 x, y;
+} Point;
+
+int main(void)
+{
+    // Every node of the list is a slot from the pool.
+    Pool nodes = initPool(sizeof(NodeLink) + sizeof(Point), 16);
+    NodeLink* head = initNodeLinkFrom(&nodes);
+    NodeLink* tail = head;
+
+    for (i32 i = 1; i < 32; i++) {
+        NodeLink* next = initNodeLinkFrom(&nodes);
+        tail->next = next;
+        tail = next;
+
+        Point* p = valueOfNodeLink(tail);
+        p->x = i;
+        p->y = i * i;
+    }
+
+    for (NodeLink* node = head->next; node != NULL; node = node->next) {
+        Point* p = valueOfNodeLink(node);
+        printfn("Point(%d, %d)", p->x, p->y);
+    }
+
+    printfn("Nodes in use: %zu", nodes.len);
+    freeNodeLinkTo(&nodes, head);
+    printfn("Nodes in use: %zu", nodes.len);
+
+    // Every key and value pair of the map is a slot from the pool.
+    Pool pairs = initPool(sizeof(u64) * 2, 0);
+    Map map = { .pool = &pairs };
+    initMap(&map);
+
+    for (u64 i = 0; i < 100; i++) {
+        u64 square = i * i;
+        putInMap(&map, &i, sizeof i, &square, sizeof square);
+    }
+
+    u64 key = 42;
+    printfn("%llu squared is %llu", (unsigned long long)key,
+            (unsigned long long)*(u64*)getFromMap(&map, &key, sizeof key));
+
+    freeMap(&map);
+    freePool(&pairs);
+    freePool(&nodes);
+}
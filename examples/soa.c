@@ -0,0 +1,42 @@
+#define MISC_IMPL
+#include "../misc.h"
+
+#define PARTICLE_FIELDS(X) \
+    X(f32, x)              \
+    X(f32, y)              \
+    X(f32, speed)          \
+    X(u32, id)
+
+DEFINE_SOA(Particles, PARTICLE_FIELDS)
+
+int main(void)
+{
+    Particles particles = {0};
+    reserveParticles(&particles, 64);
+
+    for (u32 i = 0; i < 100; i++) {
+        appendParticles(&particles, (ParticlesRow){
+            .x     = (f32)i,
+            .y     = (f32)i * 0.5f,
+            .speed = 1.0f + (f32)(i % 4),
+            .id    = i,
+        });
+    }
+
+    // Each loop touches only the columns it needs.
+    f32* x = particles.x;
+    f32* speed = particles.speed;
+    for (usize i = 0; i < particles.len; i++)
+        x[i] += speed[i];
+
+    swapRemoveParticles(&particles, 0);
+    removeParticlesRange(&particles, 10, 80);
+
+    for (usize i = 0; i < particles.len; i++) {
+        ParticlesRow p = getParticlesAt(&particles, i);
+        printfn("#%u (%.1f, %.1f)", p.id, p.x, p.y);
+    }
+
+    printfn("Capacity: %zu, Length: %zu", particles.cap, particles.len);
+    freeParticles(&particles);
+}
@@ -0,0 +1,23 @@
+#define MISC_IMPL
+#include "../misc.h"
+
+// Line, word and byte counter for stdin, try `cat big.txt | ./stream`
+
+int main(void)
+{
+    usize lines = 0, words = 0, longest = 0;
+    DelimSet spaces = initDelimSet(" \t\r");
+    StreamReader reader = initStreamReader(stdin, 0);
+    StringView line, word;
+
+    while (readLineFromStream(&reader, &line)) {
+        lines += 1;
+        if (line.len > longest) longest = line.len;
+
+        while (splitSvBySet(&line, &spaces, &word))
+            words += word.len > 0;
+    }
+
+    printfn("lines: %zu, words: %zu, longest line: %zu", lines, words, longest);
+    freeStreamReader(&reader);
+}
@@ -11,4 +11,15 @@ int main(void)
     toStringLowercase(&newer);
     reverseArray(char, &newer);
     printfn("%.*s", stringFmt(newer));
+
+    String builder = {0};
+    for (int i = 0; i < 3; i++) {
+        appendSvToString(&builder, &other);
+        appendPrintfToString(&builder, " #%d", i);
+        appendCharToString(&builder, '\n');
+    }
+    printf("%s", builder.items);
+
+    freeArray(&builder);
+    freeArray(&newer);
 }
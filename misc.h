@@ -22,7 +22,18 @@ Licensed under the MIT License. All rights reserved.
 #ifndef MISC_H
 #define MISC_H
 
+/*
+The virtual memory API is hidden by glibc in strict C99 mode, this only
+takes effect if misc.h is included first. Otherwise the flags are taken
+from the kernel headers below.
+*/
+#if defined(__linux__) && !defined(_DEFAULT_SOURCE) && !defined(_GNU_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
 #include <ctype.h>
+#include <inttypes.h>
+#include <math.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stddef.h>
@@ -31,6 +42,43 @@ Licensed under the MIT License. All rights reserved.
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if !defined(MAP_ANONYMOUS) && defined(__has_include)
+#if __has_include(<linux/mman.h>)
+#include <linux/mman.h>
+int madvise(void* addr, size_t len, int advice);
+#endif
+#endif
+#if defined(MAP_ANONYMOUS) && defined(MAP_NORESERVE) && defined(MADV_DONTNEED)
+#define MISC_HAS_MMAN
+#endif
+#endif
+
+/*
+SIMD fast paths are picked from what the compiler is allowed to emit,
+build with -mavx2 or -march=native to use them. Define MISC_NO_SIMD to
+always use the scalar code.
+*/
+#if defined(__GNUC__) && !defined(MISC_NO_SIMD)
+#if defined(__SSE2__)
+#define MISC_SSE2
+#endif
+#if defined(__SSSE3__)
+#define MISC_SSSE3
+#endif
+#if defined(__AVX2__)
+#define MISC_AVX2
+#endif
+#endif
+
+#if defined(MISC_SSE2)
+#include <immintrin.h>
+#endif
+
 typedef uint8_t u8;
 typedef int8_t i8;
 typedef uint16_t u16;
@@ -45,6 +93,18 @@ typedef float f32;
 typedef double f64;
 
 #define MISC_ALIGN (sizeof(void*))
+
+#if defined(__GNUC__)
+#define MISC_HAS_ATOMICS
+#define MISC_THREAD_LOCAL __thread
+#elif defined(_MSC_VER)
+#define MISC_THREAD_LOCAL __declspec(thread)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define MISC_THREAD_LOCAL _Thread_local
+#else
+// No thread local storage, threadArena() is shared by every thread.
+#define MISC_THREAD_LOCAL
+#endif
 #define fprintfn(f, fmt, ...) fprintf(f, fmt "\n", __VA_ARGS__)
 #define printfn(fmt, ...) fprintfn(stdout, fmt, __VA_ARGS__)
 
@@ -62,7 +122,8 @@ NodeLink* initNodeLink(usize size);
 
 NodeLink* insertAfterNodeLink(NodeLink* node, usize size);
     Insert a new node after @node, preserve the newer node as
-    its return value.
+    its return value. The rest of the list after @node is kept
+    behind the newer node.
 
 NodeLink* insertBeforeNodeLink(NodeLink* node, usize size);
     Insert a new node behind @node, return the node before @node.
@@ -76,6 +137,11 @@ void* valueOfNodeLink(NodeLink* node);
 void freeNodeLink(NodeLink* node);
     Free all node starting from @node.
 
+NodeLink* initNodeLinkWith(Allocator* allocator, usize size);
+void freeNodeLinkWith(Allocator* allocator, NodeLink* node);
+    Same as initNodeLink() and freeNodeLink(), but the memory comes
+    from @allocator.
+
 */
 
 void* strictAlloc(usize size);
@@ -112,6 +178,84 @@ void* strictRealloc(void* ptr, usize size)
 }
 #endif
 
+/*
+
+Allocator interface, a table of functions with a context.
+
+Array(T), String, Map and NodeLink can carry a pointer to one, so they
+can live in an arena, a pool or anything else. A null allocator means
+the default heap (malloc, realloc and free), that's what every
+container zero-initialized with {0} is using.
+
+The @realloc function receives the old size, so an allocator like the
+arena that doesn't remember the size of its blocks can implement it.
+The allocator object must outlive every container that points to it.
+
+API:
+void* allocWith(Allocator* allocator, usize size);
+void* callocWith(Allocator* allocator, usize n, usize size);
+void* reallocWith(Allocator* allocator, void* ptr, usize oldSize, usize newSize);
+void freeWith(Allocator* allocator, void* ptr);
+    Call the function of @allocator, or the heap if @allocator is null.
+    Return null on failure, just like the standard library.
+
+Allocator arenaAllocator(Arena* arena);
+    Allocate from @arena, freeing is a no-op, the memory is given
+    back as a whole by resetArena() or freeArena().
+
+Allocator poolAllocator(Pool* pool);
+    Allocate a slot from @pool, fails if the size is bigger than
+    the slot size.
+
+*/
+
+typedef struct {
+    void* (*alloc)(void* ctx, usize size);
+    void* (*realloc)(void* ctx, void* ptr, usize oldSize, usize newSize);
+    void (*free)(void* ctx, void* ptr);
+    void* ctx;
+} Allocator;
+
+void* allocWith(Allocator* allocator, usize size);
+void* callocWith(Allocator* allocator, usize n, usize size);
+void* reallocWith(Allocator* allocator, void* ptr, usize oldSize, usize newSize);
+void freeWith(Allocator* allocator, void* ptr);
+
+#ifdef MISC_IMPL
+void* allocWith(Allocator* allocator, usize size)
+{
+    if (allocator == NULL) return malloc(size);
+    return allocator->alloc(allocator->ctx, size);
+}
+
+void* callocWith(Allocator* allocator, usize n, usize size)
+{
+    if (allocator == NULL) return calloc(n, size);
+
+    void* p = allocator->alloc(allocator->ctx, n * size);
+    if (p != NULL) memset(p, 0, n * size);
+    return p;
+}
+
+void* reallocWith(
+    Allocator* allocator,
+    void*      ptr,
+    usize      oldSize,
+    usize      newSize)
+{
+    if (allocator == NULL) return realloc(ptr, newSize);
+    return allocator->realloc(allocator->ctx, ptr, oldSize, newSize);
+}
+
+void freeWith(Allocator* allocator, void* ptr)
+{
+    if (allocator == NULL)
+        free(ptr);
+    else if (ptr != NULL)
+        allocator->free(allocator->ctx, ptr);
+}
+#endif
+
 typedef struct NodeLink NodeLink;
 struct NodeLink {
     NodeLink* next;
@@ -119,6 +263,7 @@ struct NodeLink {
 };
 
 NodeLink* initNodeLink(usize size);
+NodeLink* initNodeLinkWith(Allocator* allocator, usize size);
 NodeLink* insertAfterNodeLink(NodeLink* node, usize size);
 NodeLink* insertBeforeNodeLink(NodeLink* node, usize size);
 NodeLink* removeAfterNodeLink(NodeLink* node);
@@ -126,6 +271,7 @@ NodeLink* findLastNodeLink(NodeLink* node);
 usize lengthOfNodeLink(NodeLink* node);
 void* valueOfNodeLink(NodeLink* node);
 void freeNodeLink(NodeLink* node);
+void freeNodeLinkWith(Allocator* allocator, NodeLink* node);
 
 #ifdef MISC_IMPL
 NodeLink* initNodeLink(usize size)
@@ -138,6 +284,7 @@ NodeLink* initNodeLink(usize size)
 NodeLink* insertAfterNodeLink(NodeLink* node, usize size)
 {
     NodeLink* next = initNodeLink(size);
+    next->next = node->next;
     node->next = next;
     return next;
 }
@@ -197,16 +344,143 @@ void freeNodeLink(NodeLink* node)
         node = tmp;
     }
 }
+
+NodeLink* initNodeLinkWith(Allocator* allocator, usize size)
+{
+    NodeLink* node = allocWith(allocator, sizeof *node + size);
+    miscAssert(node != NULL, "initNodeLinkWith() allocation failed");
+    node->next = NULL;
+    return node;
+}
+
+void freeNodeLinkWith(Allocator* allocator, NodeLink* node)
+{
+    while (node != NULL) {
+        NodeLink* tmp = node->next;
+        freeWith(allocator, node);
+        node = tmp;
+    }
+}
 #endif
 
+/*
+
+Linear allocator, backed by a linked list of chunks.
+
+Memory is never handed back one by one, instead the arena can be
+rewound into a previous point with a mark, or rewound as a whole
+with a reset. Rewinding doesn't free anything, the chunks are kept
+and reused by the next allocation, so a loop that allocate the same
+amount of memory every iteration stops calling malloc() after the
+first one.
+
+API:
+ArenaMark saveArena(Arena* arena);
+    Take a mark of the current position on @arena.
+
+void restoreArena(Arena* arena, ArenaMark mark);
+    Rewind @arena into @mark, everything allocated after @mark
+    is invalidated, the chunks are kept as a spare.
+
+void resetArena(Arena* arena);
+    Rewind @arena into its beginning.
+
+void trimArena(Arena* arena, usize keep);
+    Free the spare chunks that are not needed to keep at least
+    @keep bytes of capacity, counted from the first chunk.
+    Use this after a spike left a very long chain behind.
+
+scopeArena(arena) { ... }
+    Every allocation inside the block is rewound after the block.
+    Do not jump out of the block with break, goto or return.
+
+Arena* initArenaAligned(usize size, usize align);
+    Same as initArena(), but every allocArena() and reallocArena()
+    on it returns a block aligned to @align, a power of two.
+
+void* allocArenaAligned(Arena* arena, usize size, usize align, usize* padding);
+    Allocate @size bytes aligned to @align, a power of two, like 32
+    or 64 for SIMD buffers and cache line sized objects. The number of
+    bytes skipped to reach the alignment is stored in @padding if it
+    is not null. Returns null if @align is not a power of two.
+
+Arena* initArenaVirtual(usize reserve, u32 flags);
+    Reserve @reserve bytes of address space without backing it, the
+    pages are committed as the arena grows. The arena is one contiguous
+    region, so reallocArena() on the top block never copies and
+    sizeOfArena() returns the committed bytes. Allocating past
+    @reserve returns null. Pass MISC_ARENA_HUGEPAGES in @flags to ask
+    for transparent huge pages. On a virtual arena trimArena() gives the
+    pages past the used part (or @keep) back to the OS.
+    Linux only, returns null elsewhere.
+
+Arena* initArenaShared(usize size);
+    Make an arena that many threads can allocate from at once.
+    allocArena() and allocArenaAligned() bump the chunk with an atomic
+    compare and swap, only moving into another chunk take a lock.
+    reallocArena() is also safe, but saveArena(), restoreArena(),
+    resetArena() and trimArena() must only be called while no other
+    thread is using the arena. Returns null without GCC style atomics.
+
+Arena* threadArena(void);
+    The arena of the calling thread, made on the first call with the
+    size of MISC_THREAD_ARENA_SIZE. No locking is needed at all, so
+    this is the fastest way to allocate from many threads.
+
+void freeThreadArena(void);
+    Free the arena of the calling thread, call this before the thread
+    exit. The next threadArena() call will make a new one.
+
+*/
+
 typedef struct Arena Arena;
 #define alignUp(size) (((size) + MISC_ALIGN - 1) & ~(MISC_ALIGN - 1))
+#define alignUpTo(size, align) (((size) + (align) - 1) & ~((usize)(align) - 1))
+#define isPowerOfTwo(n) ((n) != 0 && ((n) & ((n) - 1)) == 0)
+
+// Bytes needed to move @addr forward into the next multiple of @align.
+#define alignPadding(addr, align) ((usize)(-(uintptr_t)(addr)) & ((align) - 1))
+
+#define MISC_ARENA_HUGEPAGES (1 << 0)
+
+#ifndef MISC_ARENA_COMMIT
+#define MISC_ARENA_COMMIT (64 << 10)
+#endif
+
+#ifndef MISC_HUGEPAGE_SIZE
+#define MISC_HUGEPAGE_SIZE (2 << 20)
+#endif
+
+#ifndef MISC_THREAD_ARENA_SIZE
+#define MISC_THREAD_ARENA_SIZE (64 << 10)
+#endif
+
+typedef struct {
+    NodeLink* node;
+    usize len;
+} ArenaMark;
 
 Arena* initArena(usize size);
+Arena* initArenaAligned(usize size, usize align);
+Arena* initArenaVirtual(usize reserve, u32 flags);
+Arena* initArenaShared(usize size);
+Arena* threadArena(void);
+void freeThreadArena(void);
 void* allocArena(Arena* arena, usize size);
+void* allocArenaAligned(Arena* arena, usize size, usize align, usize* padding);
+Allocator arenaAllocator(Arena* arena);
 void* reallocArena(Arena* arena, void* ptr, usize sizeBefore, usize sizeAfter);
 void freeArena(Arena* arena);
 usize sizeOfArena(Arena* arena);
+ArenaMark saveArena(Arena* arena);
+void restoreArena(Arena* arena, ArenaMark mark);
+void resetArena(Arena* arena);
+void trimArena(Arena* arena, usize keep);
+
+#define scopeArena(arena)                                              \
+    for (ArenaMark _mark = saveArena(arena), *_once = &_mark;          \
+         _once != NULL;                                                \
+         restoreArena(arena, _mark), _once = NULL)
 
 #ifdef MISC_IMPL
 typedef struct {
@@ -219,8 +493,78 @@ struct Arena {
     NodeLink
         *head,
         *last;
+    usize align;
+    usize size;
+
+    // Only for virtual arena, the whole mapping start from @head.
+    usize reserved;
+    usize committed;
+    usize granule;
+
+    // Only for shared arena, @lock guards moving into another chunk.
+    bool shared;
+    bool lock;
 };
 
+#ifdef MISC_HAS_ATOMICS
+#define atomicLoad(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define atomicStore(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define atomicCas(p, expected, desired) \
+    __atomic_compare_exchange_n((p), (expected), (desired), true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#else
+// Never used by shared arena, initArenaShared() returns null here.
+#define atomicLoad(p) (*(p))
+#define atomicStore(p, v) (*(p) = (v))
+#define atomicCas(p, expected, desired) \
+    (*(p) == *(expected) ? (*(p) = (desired), true) : (*(expected) = *(p), false))
+#endif
+
+#define arenaHeader (sizeof(NodeLink) + sizeof(ArenaBody))
+
+/*
+Make sure the payload of a virtual arena is backed until @len,
+this is a no-op for an arena made of heap chunks.
+*/
+static bool commitArena(Arena* arena, usize len)
+{
+#ifdef MISC_HAS_MMAN
+    usize needed = arenaHeader + len;
+    if (arena->reserved == 0 || needed <= arena->committed)
+        return true;
+
+    usize target = alignUpTo(needed, arena->granule);
+    if (target > arena->reserved) target = arena->reserved;
+
+    u8* base = (u8*)arena->head;
+    if (mprotect(base + arena->committed, target - arena->committed, PROT_READ | PROT_WRITE) != 0)
+        return false;
+
+    arena->committed = target;
+    arena->size = target - arenaHeader;
+#else
+    (void)arena, (void)len;
+#endif
+    return true;
+}
+
+static void decommitArena(Arena* arena, usize keep)
+{
+#ifdef MISC_HAS_MMAN
+    ArenaBody* body = valueOfNodeLink(arena->head);
+    usize used = body->len > keep ? body->len : keep;
+    usize target = alignUpTo(arenaHeader + used, arena->granule);
+    if (target >= arena->committed) return;
+
+    u8* base = (u8*)arena->head;
+    madvise(base + target, arena->committed - target, MADV_DONTNEED);
+    mprotect(base + target, arena->committed - target, PROT_NONE);
+    arena->committed = target;
+    arena->size = target - arenaHeader;
+#else
+    (void)arena, (void)keep;
+#endif
+}
+
 Arena* initArena(usize size)
 {
     if (size < 1) return NULL;
@@ -228,18 +572,212 @@ Arena* initArena(usize size)
     ArenaBody body = { .cap = size };
     arena->head = initNodeLink(sizeof body + size);
     arena->last = arena->head;
+    arena->align = MISC_ALIGN;
+    arena->size = size;
+    arena->reserved = 0;
+    arena->committed = 0;
+    arena->granule = 0;
+    arena->shared = false;
+    arena->lock = false;
 
     ArenaBody* value = valueOfNodeLink(arena->head);
     *value = body;
     return arena;
 }
 
-void* allocArena(Arena* arena, usize size)
+Arena* initArenaVirtual(usize reserve, u32 flags)
+{
+#ifdef MISC_HAS_MMAN
+    if (reserve < 1) return NULL;
+
+    bool huge = (flags & MISC_ARENA_HUGEPAGES) != 0;
+    usize granule = huge ? MISC_HUGEPAGE_SIZE : MISC_ARENA_COMMIT;
+    reserve = alignUpTo(reserve + arenaHeader, granule);
+
+    // Huge pages need the region to be aligned to the huge page size.
+    usize extra = huge ? granule : 0;
+    u8* map = mmap(NULL, reserve + extra, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (map == MAP_FAILED) return NULL;
+
+    u8* base = map;
+    if (huge) {
+        usize lead = alignPadding(map, granule);
+        if (lead > 0) munmap(map, lead);
+        if (extra - lead > 0) munmap(map + lead + reserve, extra - lead);
+        base = map + lead;
+#ifdef MADV_HUGEPAGE
+        madvise(base, reserve, MADV_HUGEPAGE);
+#endif
+    }
+
+    if (mprotect(base, granule, PROT_READ | PROT_WRITE) != 0) {
+        munmap(base, reserve);
+        return NULL;
+    }
+
+    Arena* arena = strictAlloc(sizeof *arena);
+    arena->head = (NodeLink*)base;
+    arena->head->next = NULL;
+    arena->last = arena->head;
+    arena->align = MISC_ALIGN;
+    arena->reserved = reserve;
+    arena->committed = granule;
+    arena->granule = granule;
+    arena->size = granule - arenaHeader;
+    arena->shared = false;
+    arena->lock = false;
+
+    ArenaBody* body = valueOfNodeLink(arena->head);
+    body->cap = reserve - arenaHeader;
+    body->len = 0;
+    return arena;
+#else
+    (void)reserve, (void)flags;
+    return NULL;
+#endif
+}
+
+Arena* initArenaAligned(usize size, usize align)
 {
-    if (arena == NULL || size < 1) return NULL;
+    if (!isPowerOfTwo(align)) return NULL;
+    if (align < MISC_ALIGN) align = MISC_ALIGN;
+
+    // The first block may need up to (@align - MISC_ALIGN) bytes of padding.
+    Arena* arena = initArena(size + align - MISC_ALIGN);
+    if (arena != NULL) arena->align = align;
+    return arena;
+}
 
+/*
+Move into the next spare chunk if it can hold @size bytes at @align,
+otherwise chain a new chunk right after the current one.
+*/
+static ArenaBody* nextArenaChunk(Arena* arena, usize size, usize align)
+{
     NodeLink* last = arena->last;
     ArenaBody* body = valueOfNodeLink(last);
+    NodeLink* spare = last->next;
+    ArenaBody* spareBody = spare != NULL ? valueOfNodeLink(spare) : NULL;
+    usize sparePad = spare != NULL ? alignPadding((u8*)spareBody + sizeof *spareBody, align) : 0;
+
+    if (spareBody != NULL && spareBody->cap >= sparePad + size) {
+        // Left behind by restoreArena() or resetArena(), reuse it.
+        last = spare;
+        body = spareBody;
+        body->len = 0;
+    } else {
+        usize new_size = (body->cap > size ? body->cap : size) + size + (align - MISC_ALIGN);
+        ArenaBody newer = { .cap = new_size };
+
+        last = insertAfterNodeLink(last, sizeof newer + new_size);
+        body = valueOfNodeLink(last);
+        *body = newer;
+        arena->size += new_size;
+    }
+
+    // Other threads on a shared arena must see the chunk fully made.
+    atomicStore(&arena->last, last);
+    return body;
+}
+
+static void lockArena(Arena* arena)
+{
+#ifdef MISC_HAS_ATOMICS
+    while (__atomic_test_and_set(&arena->lock, __ATOMIC_ACQUIRE))
+        while (__atomic_load_n(&arena->lock, __ATOMIC_RELAXED));
+#else
+    (void)arena;
+#endif
+}
+
+static void unlockArena(Arena* arena)
+{
+#ifdef MISC_HAS_ATOMICS
+    __atomic_clear(&arena->lock, __ATOMIC_RELEASE);
+#else
+    (void)arena;
+#endif
+}
+
+/*
+The bump is a compare and swap on the chunk length, so it never goes
+past the capacity. When the chunk is full, only one thread move the
+arena into the next chunk, the rest wait on the lock and retry.
+*/
+static void* allocArenaShared(
+    Arena* arena,
+    usize  size,
+    usize  align,
+    usize* padding)
+{
+    while (true) {
+        NodeLink* last = atomicLoad(&arena->last);
+        ArenaBody* body = valueOfNodeLink(last);
+        u8* base = (u8*)body + sizeof *body;
+        usize len = atomicLoad(&body->len);
+
+        while (true) {
+            usize pad = alignPadding(base + len, align);
+            if (body->cap - len < pad + size)
+                break;
+
+            if (atomicCas(&body->len, &len, len + pad + size)) {
+                if (padding != NULL) *padding = pad;
+                return base + len + pad;
+            }
+        }
+
+        lockArena(arena);
+        if (atomicLoad(&arena->last) == last)
+            nextArenaChunk(arena, size, align);
+        unlockArena(arena);
+    }
+}
+
+Arena* initArenaShared(usize size)
+{
+#ifdef MISC_HAS_ATOMICS
+    Arena* arena = initArena(size);
+    if (arena != NULL) arena->shared = true;
+    return arena;
+#else
+    (void)size;
+    return NULL;
+#endif
+}
+
+static MISC_THREAD_LOCAL Arena* localArena = NULL;
+
+Arena* threadArena(void)
+{
+    if (localArena == NULL)
+        localArena = initArena(MISC_THREAD_ARENA_SIZE);
+    return localArena;
+}
+
+void freeThreadArena(void)
+{
+    freeArena(localArena);
+    localArena = NULL;
+}
+
+void* allocArena(Arena* arena, usize size)
+{
+    if (arena == NULL) return NULL;
+    return allocArenaAligned(arena, size, arena->align, NULL);
+}
+
+void* allocArenaAligned(
+    Arena* arena,
+    usize  size,
+    usize  align,
+    usize* padding)
+{
+    if (arena == NULL || size < 1 || !isPowerOfTwo(align)) return NULL;
+    if (align < MISC_ALIGN) align = MISC_ALIGN;
+    if (arena->shared) return allocArenaShared(arena, alignUp(size), align, padding);
+
+    ArenaBody* body = valueOfNodeLink(arena->last);
 
     /*
     Make @size divisible by the host default alignment.
@@ -258,19 +796,25 @@ void* allocArena(Arena* arena, usize size)
     */
     size = alignUp(size);
 
-    if (body->cap - body->len < size) {
-        usize new_size = (body->cap > size ? body->cap : size) + size;
-        ArenaBody newer = { .cap = new_size };
-        NodeLink* new_tail = insertAfterNodeLink(last, sizeof newer + new_size);
-
-        arena->last = new_tail;
-        last = arena->last;
-        body = valueOfNodeLink(last);
-        *body = newer;
+    /*
+    Only the start of the block is moved forward to reach @align,
+    the @size itself is kept as is, so the padding is always less
+    than @align and reallocArena() can still tell the top block.
+    */
+    usize pad = alignPadding((u8*)body + sizeof *body + body->len, align);
+
+    if (arena->reserved != 0) {
+        // Virtual arena never chain, it only commit more pages.
+        if (body->cap - body->len < pad + size || !commitArena(arena, body->len + pad + size))
+            return NULL;
+    } else if (body->cap - body->len < pad + size) {
+        body = nextArenaChunk(arena, size, align);
+        pad = alignPadding((u8*)body + sizeof *body, align);
     }
 
-    void* ptr = (u8*)body + sizeof *body + body->len;
-    body->len += size;
+    void* ptr = (u8*)body + sizeof *body + body->len + pad;
+    body->len += pad + size;
+    if (padding != NULL) *padding = pad;
     return ptr;
 }
 
@@ -282,8 +826,30 @@ void* reallocArena(
 {
     if (arena == NULL || sizeAfter == 0) return NULL;
 
+    /*
+    If @ptr is the last block bumped out of the current chunk, then
+    nothing lives after it, so it can grow or shrink by moving the
+    chunk length, without copying anything.
+    */
+    if (ptr != NULL) {
+        ArenaBody* body = valueOfNodeLink(atomicLoad(&arena->last));
+        u8* base = (u8*)body + sizeof *body;
+        usize offset = (usize)((u8*)ptr - base);
+        usize top = offset + alignUp(sizeBefore);
+        usize end = offset + alignUp(sizeAfter);
+
+        if ((u8*)ptr >= base && top <= body->cap && body->cap - offset >= alignUp(sizeAfter)) {
+            if (arena->shared) {
+                if (atomicCas(&body->len, &top, end)) return ptr;
+            } else if (body->len == top && commitArena(arena, end)) {
+                body->len = end;
+                return ptr;
+            }
+        }
+    }
+
     void* newer = allocArena(arena, sizeAfter);
-    if (ptr == NULL) return newer;
+    if (ptr == NULL || newer == NULL) return newer;
 
     usize trueSize = sizeBefore > sizeAfter ? sizeAfter : sizeBefore;
     return memmove(newer, ptr, trueSize);
@@ -291,101 +857,413 @@ void* reallocArena(
 
 void freeArena(Arena* arena)
 {
-    if (arena != NULL) {
+    if (arena == NULL) return;
+
+#ifdef MISC_HAS_MMAN
+    if (arena->reserved != 0)
+        munmap(arena->head, arena->reserved);
+    else
+#endif
         freeNodeLink(arena->head);
-        free(arena);
-    }
+    free(arena);
 }
 
 usize sizeOfArena(Arena* arena)
 {
-    usize size = 0;
-    if (arena == NULL) return size;
+    return arena != NULL ? arena->size : 0;
+}
 
-    NodeLink* node = arena->head;
-    while (node != NULL) {
+static void* arenaAllocatorAlloc(void* ctx, usize size)
+{
+    return allocArena(ctx, size);
+}
+
+static void* arenaAllocatorRealloc(
+    void* ctx,
+    void* ptr,
+    usize oldSize,
+    usize newSize)
+{
+    return reallocArena(ctx, ptr, oldSize, newSize);
+}
+
+static void arenaAllocatorFree(void* ctx, void* ptr)
+{
+    (void)ctx, (void)ptr;
+}
+
+Allocator arenaAllocator(Arena* arena)
+{
+    return (Allocator){
+        .alloc   = arenaAllocatorAlloc,
+        .realloc = arenaAllocatorRealloc,
+        .free    = arenaAllocatorFree,
+        .ctx     = arena,
+    };
+}
+
+ArenaMark saveArena(Arena* arena)
+{
+    ArenaMark mark = {0};
+    if (arena == NULL) return mark;
+
+    ArenaBody* body = valueOfNodeLink(arena->last);
+    mark.node = arena->last;
+    mark.len = body->len;
+    return mark;
+}
+
+void restoreArena(Arena* arena, ArenaMark mark)
+{
+    if (arena == NULL || mark.node == NULL) return;
+
+    // Every chunk after the mark until the current one is emptied.
+    NodeLink* node = mark.node->next;
+    while (node != NULL && node != arena->last->next) {
         ArenaBody* body = valueOfNodeLink(node);
-        size += body->cap;
+        body->len = 0;
         node = node->next;
     }
-    return size;
+
+    ArenaBody* body = valueOfNodeLink(mark.node);
+    body->len = mark.len;
+    arena->last = mark.node;
 }
-#endif
 
-#define MISC_ARRAY_RESERVE (8)
+void resetArena(Arena* arena)
+{
+    if (arena == NULL) return;
+    restoreArena(arena, (ArenaMark){ .node = arena->head, .len = 0 });
+}
 
-#define Array(T)    \
-    struct {        \
-        T* items;   \
-        usize cap;  \
-        usize len;  \
+void trimArena(Arena* arena, usize keep)
+{
+    if (arena == NULL) return;
+    if (arena->reserved != 0) {
+        decommitArena(arena, keep);
+        return;
     }
 
-#define isArrayEmpty(array) ((array) != NULL ? ((array)->items == NULL || (array)->cap < 1) : 1)
-#define remainsOfArray(array) ((array) != NULL ? ((array)->cap - (array)->len) : 0)
+    usize total = 0;
+    NodeLink* node = arena->head;
+    while (true) {
+        ArenaBody* body = valueOfNodeLink(node);
+        total += body->cap;
+        if (node == arena->last) break;
+        node = node->next;
+    }
 
-#define tryResizeArray(array, N, ok)                                         \
-    do {                                                                     \
-        if ((N) <= 0) {                                                      \
-            free((array)->items);                                            \
-            (array)->items = NULL;                                           \
-            (array)->cap = 0;                                                \
-            (array)->len = 0;                                                \
-            *(ok) = 1;                                                       \
-        } else {                                                             \
-            void* tmp;                                                       \
-            if ((array)->cap == 0) {                                         \
-                tmp = calloc((N), sizeof *(array)->items);                   \
-            } else {                                                         \
-                tmp = realloc((array)->items, (N) * sizeof *(array)->items); \
-            }                                                                \
-            if (tmp != NULL) {                                               \
-                *(ok) = 1;                                                   \
-                (array)->items = tmp;                                        \
-                (array)->cap = (N);                                          \
-                if ((N) < (array)->len) {                                    \
-                    (array)->len = (N);                                      \
-                }                                                            \
-            } else {                                                         \
-                *(ok) = 0;                                                   \
-            }                                                                \
-        }                                                                    \
-    } while (0)
+    // Only the spare chunks after the current one can be freed.
+    while (node->next != NULL) {
+        ArenaBody* body = valueOfNodeLink(node->next);
+        if (total + body->cap <= keep) {
+            total += body->cap;
+            node = node->next;
+        } else {
+            arena->size -= body->cap;
+            free(removeAfterNodeLink(node));
+        }
+    }
+}
+#endif
 
-#define tryAppendArray(array, item, ok)                                     \
-    do {                                                                    \
-        if ((array)->cap <= (array)->len) {                                 \
-            tryResizeArray(array, (array)->cap + MISC_ARRAY_RESERVE, ok);   \
-        }                                                                   \
-        if (*(ok)) {                                                        \
-            (array)->items[(array)->len++] = (item);                        \
-        }                                                                   \
-    } while (0)
+/*
 
-#define tryExtendArray(array, many_ptr, N, ok)                                                \
-    do {                                                                                      \
-        if ((many_ptr) != NULL && (N) > 0) {                                                  \
-            if (isArrayEmpty(array) || remainsOfArray(array) <= (N)) {                        \
-                tryResizeArray(array, (array)->cap + (N) + MISC_ARRAY_RESERVE, ok);           \
-                if (!*(ok)) {                                                                 \
-                    break;                                                                    \
-                }                                                                             \
-            }                                                                                 \
-            memmove((array)->items + (array)->len, (many_ptr), (N) * sizeof *(array)->items); \
-            (array)->len += (N);                                                              \
-            *(ok) = 1;                                                                        \
-        } else {                                                                              \
-            *(ok) = 0;                                                                        \
-        }                                                                                     \
-    } while (0)
+Pool allocator, for a lot of objects with the same size.
 
-#define resizeArray(array, N)                   \
-    do {                                        \
+Memory is requested from malloc() as a slab, a big page that is
+carved into fixed-size slots. A released slot is pushed into a free
+list, the link is stored inside the slot itself using the NodeLink
+layout, so a slot doesn't carry any header and both allocation and
+release are O(1).
+
+API:
+Pool initPool(usize slotSize, usize slotsPerSlab);
+    Make a pool that hand out @slotSize bytes per allocation, every slab
+    holds @slotsPerSlab slots (MISC_POOL_SLAB_SLOTS if 0). Nothing is
+    allocated until the first allocPool().
+
+void* allocPool(Pool* pool);
+    Take a slot, reusing a released one first.
+
+void releaseToPool(Pool* pool, void* ptr);
+    Give the slot @ptr back to @pool.
+
+void freePool(Pool* pool);
+    Free every slab, all the slots are invalidated.
+
+NodeLink* initNodeLinkFrom(Pool* pool);
+    Same as initNodeLink(), but the node is a slot of @pool, the value
+    size is the slot size minus sizeof(NodeLink).
+
+void freeNodeLinkTo(Pool* pool, NodeLink* node);
+    Same as freeNodeLink(), but release every node back into @pool.
+
+*/
+
+#ifndef MISC_POOL_SLAB_SLOTS
+#define MISC_POOL_SLAB_SLOTS (64)
+#endif
+
+typedef struct {
+    NodeLink* slabs;
+    NodeLink* freeList;
+    u8* bump;
+    u8* end;
+    usize slotSize;
+    usize slotsPerSlab;
+    usize len;
+} Pool;
+
+Pool initPool(usize slotSize, usize slotsPerSlab);
+void* allocPool(Pool* pool);
+void releaseToPool(Pool* pool, void* ptr);
+void freePool(Pool* pool);
+NodeLink* initNodeLinkFrom(Pool* pool);
+void freeNodeLinkTo(Pool* pool, NodeLink* node);
+Allocator poolAllocator(Pool* pool);
+
+#ifdef MISC_IMPL
+Pool initPool(usize slotSize, usize slotsPerSlab)
+{
+    // A free slot must be able to hold the free list link.
+    if (slotSize < sizeof(NodeLink)) slotSize = sizeof(NodeLink);
+
+    return (Pool){
+        .slotSize     = alignUp(slotSize),
+        .slotsPerSlab = slotsPerSlab > 0 ? slotsPerSlab : MISC_POOL_SLAB_SLOTS,
+    };
+}
+
+void* allocPool(Pool* pool)
+{
+    if (pool == NULL || pool->slotSize < 1) return NULL;
+    pool->len++;
+
+    if (pool->freeList != NULL) {
+        NodeLink* slot = pool->freeList;
+        pool->freeList = slot->next;
+        return slot;
+    }
+
+    /*
+    The newest slab is carved lazily, so a fresh slab never touch
+    the memory of the slots that are not used yet.
+    */
+    if (pool->bump == pool->end) {
+        NodeLink* slab = insertBeforeNodeLink(pool->slabs, pool->slotSize * pool->slotsPerSlab);
+        pool->slabs = slab;
+        pool->bump = valueOfNodeLink(slab);
+        pool->end = pool->bump + pool->slotSize * pool->slotsPerSlab;
+    }
+
+    void* ptr = pool->bump;
+    pool->bump += pool->slotSize;
+    return ptr;
+}
+
+void releaseToPool(Pool* pool, void* ptr)
+{
+    if (pool == NULL || ptr == NULL) return;
+
+    NodeLink* slot = ptr;
+    slot->next = pool->freeList;
+    pool->freeList = slot;
+    pool->len--;
+}
+
+void freePool(Pool* pool)
+{
+    if (pool == NULL) return;
+    freeNodeLink(pool->slabs);
+    *pool = initPool(pool->slotSize, pool->slotsPerSlab);
+}
+
+NodeLink* initNodeLinkFrom(Pool* pool)
+{
+    NodeLink* node = allocPool(pool);
+    miscAssert(node != NULL, "initNodeLinkFrom() on an empty pool");
+    node->next = NULL;
+    return node;
+}
+
+void freeNodeLinkTo(Pool* pool, NodeLink* node)
+{
+    while (node != NULL) {
+        NodeLink* tmp = node->next;
+        releaseToPool(pool, node);
+        node = tmp;
+    }
+}
+
+static void* poolAllocatorAlloc(void* ctx, usize size)
+{
+    Pool* pool = ctx;
+    return size <= pool->slotSize ? allocPool(pool) : NULL;
+}
+
+static void* poolAllocatorRealloc(
+    void* ctx,
+    void* ptr,
+    usize oldSize,
+    usize newSize)
+{
+    Pool* pool = ctx;
+    (void)oldSize;
+    if (newSize > pool->slotSize) return NULL;
+    return ptr != NULL ? ptr : allocPool(pool);
+}
+
+static void poolAllocatorFree(void* ctx, void* ptr)
+{
+    releaseToPool(ctx, ptr);
+}
+
+Allocator poolAllocator(Pool* pool)
+{
+    return (Allocator){
+        .alloc   = poolAllocatorAlloc,
+        .realloc = poolAllocatorRealloc,
+        .free    = poolAllocatorFree,
+        .ctx     = pool,
+    };
+}
+#endif
+
+#define MISC_ARRAY_RESERVE (8)
+
+/*
+Growth policy of Array(T), the capacity is multiplied by
+MISC_ARRAY_GROWTH_NUM / MISC_ARRAY_GROWTH_DEN (2 by default) every time
+the array is full, so appending N items costs O(N) copies in total.
+Define MISC_ARRAY_CONSTANT_GROWTH to grow by MISC_ARRAY_RESERVE items
+instead, which waste less memory but copy O(N²) items.
+These must be defined before the implementation of this header.
+
+reserveArray(array, N) makes sure the capacity is at least N items
+without ever shrinking it, so a known amount of appends never grow.
+*/
+#ifndef MISC_ARRAY_GROWTH_NUM
+#define MISC_ARRAY_GROWTH_NUM (2)
+#endif
+
+#ifndef MISC_ARRAY_GROWTH_DEN
+#define MISC_ARRAY_GROWTH_DEN (1)
+#endif
+
+#if MISC_ARRAY_GROWTH_NUM <= MISC_ARRAY_GROWTH_DEN
+#error Growth factor must be greater than 1
+#endif
+
+// Next capacity for an array with @cap items that needs @need items.
+usize growCapacity(usize cap, usize need);
+
+#ifdef MISC_IMPL
+usize growCapacity(usize cap, usize need)
+{
+#ifdef MISC_ARRAY_CONSTANT_GROWTH
+    usize next = cap + MISC_ARRAY_RESERVE;
+    return next >= need ? next : need + MISC_ARRAY_RESERVE;
+#else
+    usize next = cap / MISC_ARRAY_GROWTH_DEN * MISC_ARRAY_GROWTH_NUM +
+                 cap % MISC_ARRAY_GROWTH_DEN * MISC_ARRAY_GROWTH_NUM / MISC_ARRAY_GROWTH_DEN;
+    if (next < MISC_ARRAY_RESERVE) next = MISC_ARRAY_RESERVE;
+    return next >= need ? next : need;
+#endif
+}
+#endif
+
+#define Array(T)              \
+    struct {                  \
+        T* items;             \
+        usize cap;            \
+        usize len;            \
+        Allocator* allocator; \
+    }
+
+#define isArrayEmpty(array) ((array) != NULL ? ((array)->items == NULL || (array)->cap < 1) : 1)
+#define remainsOfArray(array) ((array) != NULL ? ((array)->cap - (array)->len) : 0)
+
+#define tryResizeArray(array, N, ok)                                               \
+    do {                                                                           \
+        if ((N) <= 0) {                                                            \
+            freeWith((array)->allocator, (array)->items);                          \
+            (array)->items = NULL;                                                 \
+            (array)->cap = 0;                                                      \
+            (array)->len = 0;                                                      \
+            *(ok) = 1;                                                             \
+        } else {                                                                   \
+            void* tmp;                                                             \
+            if ((array)->cap == 0) {                                               \
+                tmp = callocWith((array)->allocator, (N), sizeof *(array)->items); \
+            } else {                                                               \
+                tmp = reallocWith((array)->allocator, (array)->items,              \
+                                  (array)->cap * sizeof *(array)->items,           \
+                                  (N) * sizeof *(array)->items);                   \
+            }                                                                      \
+            if (tmp != NULL) {                                                     \
+                *(ok) = 1;                                                         \
+                (array)->items = tmp;                                              \
+                (array)->cap = (N);                                                \
+                if ((N) < (array)->len) {                                          \
+                    (array)->len = (N);                                            \
+                }                                                                  \
+            } else {                                                               \
+                *(ok) = 0;                                                         \
+            }                                                                      \
+        }                                                                          \
+    } while (0)
+
+#define tryReserveArray(array, N, ok)       \
+    do {                                    \
+        *(ok) = 1;                          \
+        if ((array)->cap < (N)) {           \
+            tryResizeArray(array, (N), ok); \
+        }                                   \
+    } while (0)
+
+#define tryAppendArray(array, item, ok)                                              \
+    do {                                                                             \
+        *(ok) = 1;                                                                   \
+        if ((array)->cap <= (array)->len) {                                          \
+            tryResizeArray(array, growCapacity((array)->cap, (array)->len + 1), ok); \
+        }                                                                            \
+        if (*(ok)) {                                                                 \
+            (array)->items[(array)->len++] = (item);                                 \
+        }                                                                            \
+    } while (0)
+
+#define tryExtendArray(array, many_ptr, N, ok)                                                \
+    do {                                                                                      \
+        if ((many_ptr) != NULL && (N) > 0) {                                                  \
+            if (isArrayEmpty(array) || remainsOfArray(array) < (N)) {                         \
+                tryResizeArray(array, growCapacity((array)->cap, (array)->len + (N)), ok);    \
+                if (!*(ok)) {                                                                 \
+                    break;                                                                    \
+                }                                                                             \
+            }                                                                                 \
+            memmove((array)->items + (array)->len, (many_ptr), (N) * sizeof *(array)->items); \
+            (array)->len += (N);                                                              \
+            *(ok) = 1;                                                                        \
+        } else {                                                                              \
+            *(ok) = 0;                                                                        \
+        }                                                                                     \
+    } while (0)
+
+#define resizeArray(array, N)                   \
+    do {                                        \
         bool ok;                                \
         tryResizeArray(array, N, &ok);          \
         miscAssert(ok, "resizeArray() failed"); \
     } while (0)
 
+#define reserveArray(array, N)                   \
+    do {                                         \
+        bool ok;                                 \
+        tryReserveArray(array, N, &ok);          \
+        miscAssert(ok, "reserveArray() failed"); \
+    } while (0)
+
 #define appendArray(array, item)                \
     do {                                        \
         bool ok;                                \
@@ -400,15 +1278,59 @@ usize sizeOfArena(Arena* arena)
         miscAssert(ok, "extendArray() failed");  \
     } while (0)
 
-#define removeArrayAt(array, index)                                               \
-    do {                                                                          \
-        if ((array)->len > 1 && (index) < (array)->len) {                         \
-            for (usize i = (index); i < (array)->len - 1; i++) {                  \
-                (array)->items[i] = (array)->items[i + 1];                        \
-            }                                                                     \
-            memset(&(array)->items[(array)->len - 1], 0, sizeof *(array)->items); \
-            (array)->len--;                                                       \
-        }                                                                         \
+/*
+removeArrayRange(array, begin, count)
+    Remove @count items starting from @begin with one memmove(),
+    clamped to the length.
+
+removeArrayAt(array, index)
+    Remove one item, keeping the order.
+
+swapRemoveArray(array, index)
+    Remove one item in O(1) by moving the last item into its place,
+    the order is not kept.
+
+retainArray(array, pred)
+    Keep only the items where pred(&item) is true, keeping their order,
+    in a single pass. @pred can be a function or a function-like macro.
+
+The slots left behind by every remove are zeroed.
+*/
+#define removeArrayRange(array, begin, count)                                      \
+    do {                                                                           \
+        if ((begin) < (array)->len) {                                              \
+            usize _tail = (array)->len - (begin);                                  \
+            usize _n = (count) < _tail ? (count) : _tail;                          \
+            memmove((array)->items + (begin), (array)->items + (begin) + _n,       \
+                    (_tail - _n) * sizeof *(array)->items);                        \
+            (array)->len -= _n;                                                    \
+            memset((array)->items + (array)->len, 0, _n * sizeof *(array)->items); \
+        }                                                                          \
+    } while (0)
+
+#define removeArrayAt(array, index) removeArrayRange(array, index, 1)
+
+#define swapRemoveArray(array, index)                                         \
+    do {                                                                      \
+        if ((index) < (array)->len) {                                         \
+            (array)->len--;                                                   \
+            (array)->items[(index)] = (array)->items[(array)->len];           \
+            memset(&(array)->items[(array)->len], 0, sizeof *(array)->items); \
+        }                                                                     \
+    } while (0)
+
+#define retainArray(array, pred)                                                                \
+    do {                                                                                        \
+        usize _kept = 0;                                                                        \
+        for (usize _i = 0; _i < (array)->len; _i++) {                                           \
+            if (pred(&(array)->items[_i])) {                                                    \
+                if (_kept != _i) (array)->items[_kept] = (array)->items[_i];                    \
+                _kept++;                                                                        \
+            }                                                                                   \
+        }                                                                                       \
+        if ((array)->len > _kept)                                                               \
+            memset((array)->items + _kept, 0, ((array)->len - _kept) * sizeof *(array)->items); \
+        (array)->len = _kept;                                                                   \
     } while (0)
 
 #define reverseArray(T, array)                                \
@@ -427,8 +1349,8 @@ usize sizeOfArena(Arena* arena)
 #define tryAppendArrayAt(array, idx, item, ok)                                                                              \
     do {                                                                                                                    \
         if ((idx) < (array)->len) {                                                                                         \
-            if ((array)->cap - (array)->len <= 1) {                                                                         \
-                tryResizeArray(array, (array)->cap + MISC_ARRAY_RESERVE, ok);                                               \
+            if ((array)->cap <= (array)->len) {                                                                             \
+                tryResizeArray(array, growCapacity((array)->cap, (array)->len + 1), ok);                                    \
                 if (!*(ok)) break;                                                                                          \
             }                                                                                                               \
             memmove((array)->items + ((idx) + 1), (array)->items + (idx), ((array)->len - (idx)) * sizeof *(array)->items); \
@@ -450,6 +1372,473 @@ usize sizeOfArena(Arena* arena)
 #define shrinkArrayToFit(array) resizeArray(array, (array)->len)
 #define freeArray(array) resizeArray(array, 0)
 
+/*
+
+Array(T) with inline storage for the first N items.
+
+The items live inside the struct itself until the array needs more
+than N items, then they are moved into the heap, so a short array
+never calls malloc(). It has the same layout as Array(T) at the front,
+so every Array(T) macro works on it, the switch is done by its own
+allocator. shrinkArrayToFit() moves the items back inline if they fit.
+
+A SmallArray must be initialized with initSmallArray(), and must not be
+copied or moved after that, because @items may point into itself.
+A SmallArray zero-initialized with {0} works like a plain Array(T).
+
+SmallArray(i32, 16) ints;
+initSmallArray(&ints);
+appendArray(&ints, 42);
+freeArray(&ints);
+
+*/
+
+typedef struct {
+    Allocator allocator;
+    void* buffer;
+    usize size;
+} InlineStore;
+
+void initInlineStore(InlineStore* store, void* buffer, usize size);
+
+#define SmallArray(T, N)      \
+    struct {                  \
+        T* items;             \
+        usize cap;            \
+        usize len;            \
+        Allocator* allocator; \
+        InlineStore store;    \
+        T inlineItems[N];     \
+    }
+
+#define initSmallArray(array)                                                                \
+    do {                                                                                     \
+        initInlineStore(&(array)->store, (array)->inlineItems, sizeof (array)->inlineItems); \
+        (array)->allocator = &(array)->store.allocator;                                      \
+        (array)->items = (array)->inlineItems;                                               \
+        (array)->cap = sizeof (array)->inlineItems / sizeof *(array)->inlineItems;           \
+        (array)->len = 0;                                                                    \
+    } while (0)
+
+#ifdef MISC_IMPL
+static void* inlineStoreAlloc(void* ctx, usize size)
+{
+    InlineStore* store = ctx;
+    return size <= store->size ? store->buffer : malloc(size);
+}
+
+static void* inlineStoreRealloc(
+    void* ctx,
+    void* ptr,
+    usize oldSize,
+    usize newSize)
+{
+    InlineStore* store = ctx;
+    if (ptr == store->buffer) {
+        if (newSize <= store->size) return ptr;
+
+        void* heap = malloc(newSize);
+        if (heap != NULL) memcpy(heap, ptr, oldSize);
+        return heap;
+    }
+
+    if (newSize <= store->size) {
+        memcpy(store->buffer, ptr, newSize);
+        free(ptr);
+        return store->buffer;
+    }
+    return realloc(ptr, newSize);
+}
+
+static void inlineStoreFree(void* ctx, void* ptr)
+{
+    InlineStore* store = ctx;
+    if (ptr != store->buffer) free(ptr);
+}
+
+void initInlineStore(InlineStore* store, void* buffer, usize size)
+{
+    store->allocator = (Allocator){
+        .alloc   = inlineStoreAlloc,
+        .realloc = inlineStoreRealloc,
+        .free    = inlineStoreFree,
+        .ctx     = store,
+    };
+    store->buffer = buffer;
+    store->size = size;
+}
+#endif
+
+
+/*
+
+Struct of arrays, generated from a list of fields.
+
+Array(T) stores whole records next to each other. When a loop only
+reads one field of a wide record, most of every cache line is wasted.
+A struct of arrays stores every field in its own column instead, all
+the columns share one length and capacity, and each column starts on
+a MISC_SOA_ALIGN boundary so a loop over it can be vectorized.
+
+The fields are given as an X macro:
+
+#define PARTICLE_FIELDS(X) \
+    X(f32, x)              \
+    X(f32, y)              \
+    X(u32, id)
+
+DEFINE_SOA(Particles, PARTICLE_FIELDS)
+
+Generates the record type ParticlesRow { f32 x; f32 y; u32 id; } and
+the container Particles { f32* x; f32* y; u32* id; usize cap; usize len;
+Allocator* allocator; ... }, zero-initialize it with {0}. Read or write
+a column directly with particles.x[i].
+
+API:
+bool tryReserve##name(name* soa, usize cap);
+void reserve##name(name* soa, usize cap);
+    Make sure the capacity is at least @cap, never shrink.
+
+bool tryAppend##name(name* soa, name##Row row);
+void append##name(name* soa, name##Row row);
+    Append a record, growing like Array(T) does.
+
+name##Row get##name##At(name* soa, usize index);
+    Gather the record at @index from every column.
+
+void remove##name##Range(name* soa, usize begin, usize count);
+void remove##name##At(name* soa, usize index);
+void swapRemove##name(name* soa, usize index);
+    Same as the Array(T) macros, on every column.
+
+void free##name(name* soa);
+    Free every column, @allocator is kept.
+
+*/
+
+#ifndef MISC_SOA_ALIGN
+#define MISC_SOA_ALIGN (64)
+#endif
+
+#define soaFieldPointer(T, field) T* field;
+#define soaFieldValue(T, field) T field;
+#define soaFieldSize(T, field) size = alignUpTo(size, MISC_SOA_ALIGN) + cap * sizeof(T);
+#define soaFieldMove(T, field)                                                 \
+    offset = alignUpTo(offset, MISC_SOA_ALIGN);                                \
+    if (soa->len > 0) memcpy(base + offset, soa->field, soa->len * sizeof(T)); \
+    soa->field = (T*)(base + offset);                                          \
+    offset += cap * sizeof(T);
+#define soaFieldPush(T, field) soa->field[soa->len] = row.field;
+#define soaFieldGet(T, field) row.field = soa->field[index];
+#define soaFieldErase(T, field)                                                                      \
+    memmove(soa->field + begin, soa->field + begin + count, (soa->len - begin - count) * sizeof(T)); \
+    memset(soa->field + soa->len - count, 0, count * sizeof(T));
+#define soaFieldSwap(T, field)                          \
+    soa->field[index] = soa->field[soa->len - 1];       \
+    memset(&soa->field[soa->len - 1], 0, sizeof(T));
+
+#define DEFINE_SOA(name, fields)                                                \
+    typedef struct {                                                            \
+        fields(soaFieldValue)                                                   \
+    } name##Row;                                                                \
+                                                                                \
+    typedef struct {                                                            \
+        fields(soaFieldPointer)                                                 \
+        usize cap;                                                              \
+        usize len;                                                              \
+        Allocator* allocator;                                                   \
+        void* block;                                                            \
+    } name;                                                                     \
+                                                                                \
+    static inline bool tryReserve##name(name* soa, usize cap)                   \
+    {                                                                           \
+        if (cap <= soa->cap) return true;                                       \
+                                                                                \
+        /* Every column is carved from one block, in declaration order. */      \
+        usize size = 0, offset = 0;                                             \
+        fields(soaFieldSize)                                                    \
+        void* block = allocWith(soa->allocator, size + MISC_SOA_ALIGN - 1);     \
+        if (block == NULL) return false;                                        \
+                                                                                \
+        u8* base = (u8*)block + alignPadding(block, MISC_SOA_ALIGN);            \
+        fields(soaFieldMove)                                                    \
+        (void)offset;                                                           \
+        freeWith(soa->allocator, soa->block);                                   \
+        soa->block = block;                                                     \
+        soa->cap = cap;                                                         \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    static inline void reserve##name(name* soa, usize cap)                      \
+    {                                                                           \
+        miscAssert(tryReserve##name(soa, cap), "reserve" #name "() failed");    \
+    }                                                                           \
+                                                                                \
+    static inline bool tryAppend##name(name* soa, name##Row row)                \
+    {                                                                           \
+        if (soa->cap <= soa->len &&                                             \
+            !tryReserve##name(soa, growCapacity(soa->cap, soa->len + 1)))       \
+            return false;                                                       \
+        fields(soaFieldPush)                                                    \
+        soa->len++;                                                             \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    static inline void append##name(name* soa, name##Row row)                   \
+    {                                                                           \
+        miscAssert(tryAppend##name(soa, row), "append" #name "() failed");      \
+    }                                                                           \
+                                                                                \
+    static inline name##Row get##name##At(name* soa, usize index)               \
+    {                                                                           \
+        name##Row row;                                                          \
+        fields(soaFieldGet)                                                     \
+        return row;                                                             \
+    }                                                                           \
+                                                                                \
+    static inline void remove##name##Range(name* soa, usize begin, usize count) \
+    {                                                                           \
+        if (begin >= soa->len) return;                                          \
+        if (count > soa->len - begin) count = soa->len - begin;                 \
+        fields(soaFieldErase)                                                   \
+        soa->len -= count;                                                      \
+    }                                                                           \
+                                                                                \
+    static inline void remove##name##At(name* soa, usize index)                 \
+    {                                                                           \
+        remove##name##Range(soa, index, 1);                                     \
+    }                                                                           \
+                                                                                \
+    static inline void swapRemove##name(name* soa, usize index)                 \
+    {                                                                           \
+        if (index >= soa->len) return;                                          \
+        fields(soaFieldSwap)                                                    \
+        soa->len--;                                                             \
+    }                                                                           \
+                                                                                \
+    static inline void free##name(name* soa)                                    \
+    {                                                                           \
+        Allocator* allocator = soa->allocator;                                  \
+        freeWith(allocator, soa->block);                                        \
+        memset(soa, 0, sizeof *soa);                                            \
+        soa->allocator = allocator;                                             \
+    }
+
+/*
+
+Sorting and searching, specialized per type at compile time.
+Each macro generates static functions for one element type, so the
+comparison is inlined instead of going through a function pointer
+like qsort() does. Use it on an array with sortI32(ints.items, ints.len).
+
+@less(a, b) is called with two T and must be true if a goes before b,
+it can be a function-like macro like: #define lessI32(a, b) ((a) < (b))
+@keyOf(item) must return an u64 that sorts in the same order as the
+item, see the radixKey helpers for signed and floating point keys.
+
+API:
+DEFINE_SORT(name, T, less)
+    void sort##name(T* items, usize len);
+    Introsort: quicksort with a median of 3 pivot, insertion sort
+    for small partitions, and heapsort if the recursion goes too deep,
+    so the worst case stays O(N log N). Not stable.
+
+DEFINE_RADIX_SORT(name, T, keyOf)
+    void radixSort##name(T* items, usize len);
+    LSD radix sort, 8 bits per pass. Passes where every key has the
+    same digit are skipped, so narrow keys are cheaper. Stable, but
+    allocates a temporary copy of @items.
+
+DEFINE_BOUNDS(name, T, less)
+    usize lowerBound##name(const T* items, usize len, T value);
+        First index where the item is not less than @value.
+    usize upperBound##name(const T* items, usize len, T value);
+        First index where @value is less than the item.
+    Both return @len if there's no such item, @items must be sorted.
+
+*/
+
+#define MISC_SORT_THRESHOLD (24)
+
+#define radixKeyU64(x) ((u64)(x))
+#define radixKeyI32(x) ((u64)((u32)(x) ^ 0x80000000u))
+#define radixKeyI64(x) ((u64)(x) ^ 0x8000000000000000ULL)
+
+static inline u64 radixKeyF32(f32 x)
+{
+    u32 bits;
+    memcpy(&bits, &x, sizeof bits);
+    return (bits & 0x80000000u) ? ~bits & 0xffffffffu : bits | 0x80000000u;
+}
+
+static inline u64 radixKeyF64(f64 x)
+{
+    u64 bits;
+    memcpy(&bits, &x, sizeof bits);
+    return (bits & 0x8000000000000000ULL) ? ~bits : bits | 0x8000000000000000ULL;
+}
+
+#define DEFINE_SORT(name, T, less)                                          \
+    static inline void insertionSort##name(T* items, usize len)             \
+    {                                                                       \
+        for (usize i = 1; i < len; i++) {                                   \
+            T item = items[i];                                              \
+            usize j = i;                                                    \
+            while (j > 0 && less(item, items[j - 1])) {                     \
+                items[j] = items[j - 1];                                    \
+                j--;                                                        \
+            }                                                               \
+            items[j] = item;                                                \
+        }                                                                   \
+    }                                                                       \
+                                                                            \
+    static inline void siftDown##name(T* items, usize root, usize len)      \
+    {                                                                       \
+        T item = items[root];                                               \
+        while (true) {                                                      \
+            usize child = root * 2 + 1;                                     \
+            if (child >= len) break;                                        \
+            if (child + 1 < len && less(items[child], items[child + 1]))    \
+                child++;                                                    \
+            if (!less(item, items[child])) break;                           \
+            items[root] = items[child];                                     \
+            root = child;                                                   \
+        }                                                                   \
+        items[root] = item;                                                 \
+    }                                                                       \
+                                                                            \
+    static inline void heapSort##name(T* items, usize len)                  \
+    {                                                                       \
+        for (usize i = len / 2; i-- > 0;)                                   \
+            siftDown##name(items, i, len);                                  \
+        for (usize i = len - 1; i > 0; i--) {                               \
+            T tmp = items[0];                                               \
+            items[0] = items[i];                                            \
+            items[i] = tmp;                                                 \
+            siftDown##name(items, 0, i);                                    \
+        }                                                                   \
+    }                                                                       \
+                                                                            \
+    static inline void swapSort##name(T* items, usize a, usize b)           \
+    {                                                                       \
+        T tmp = items[a];                                                   \
+        items[a] = items[b];                                                \
+        items[b] = tmp;                                                     \
+    }                                                                       \
+                                                                            \
+    static inline void introSort##name(T* items, usize len, usize depth)    \
+    {                                                                       \
+        while (len > MISC_SORT_THRESHOLD) {                                 \
+            if (depth-- == 0) {                                             \
+                heapSort##name(items, len);                                 \
+                return;                                                     \
+            }                                                               \
+                                                                            \
+            /* items[0] <= items[mid] <= items[len - 1], then the median */ \
+            /* becomes the pivot on items[0], both ends act as sentinel. */ \
+            usize mid = len / 2;                                            \
+            if (less(items[mid], items[0])) swapSort##name(items, mid, 0);  \
+            if (less(items[len - 1], items[mid]))                           \
+                swapSort##name(items, len - 1, mid);                        \
+            if (less(items[mid], items[0])) swapSort##name(items, mid, 0);  \
+            swapSort##name(items, 0, mid);                                  \
+                                                                            \
+            T pivot = items[0];                                             \
+            usize i = 0, j = len;                                           \
+            while (true) {                                                  \
+                do i++; while (less(items[i], pivot));                      \
+                do j--; while (less(pivot, items[j]));                      \
+                if (i >= j) break;                                          \
+                swapSort##name(items, i, j);                                \
+            }                                                               \
+            swapSort##name(items, 0, j);                                    \
+                                                                            \
+            /* Recurse into the smaller side, loop on the bigger one. */    \
+            if (j < len - j - 1) {                                          \
+                introSort##name(items, j, depth);                           \
+                items += j + 1;                                             \
+                len -= j + 1;                                               \
+            } else {                                                        \
+                introSort##name(items + j + 1, len - j - 1, depth);         \
+                len = j;                                                    \
+            }                                                               \
+        }                                                                   \
+        insertionSort##name(items, len);                                    \
+    }                                                                       \
+                                                                            \
+    static inline void sort##name(T* items, usize len)                      \
+    {                                                                       \
+        usize depth = 0;                                                    \
+        for (usize n = len; n > 1; n >>= 1)                                 \
+            depth += 2;                                                     \
+        if (len > 1) introSort##name(items, len, depth);                    \
+    }
+
+#define DEFINE_RADIX_SORT(name, T, keyOf)                                     \
+    static inline void radixSort##name(T* items, usize len)                   \
+    {                                                                         \
+        if (len < 2) return;                                                  \
+                                                                              \
+        /* One read pass to count the digits of every pass. */                \
+        usize count[8][256];                                                  \
+        memset(count, 0, sizeof count);                                       \
+        for (usize i = 0; i < len; i++) {                                     \
+            u64 key = keyOf(items[i]);                                        \
+            for (usize pass = 0; pass < 8; pass++)                            \
+                count[pass][(key >> (pass * 8)) & 0xff]++;                    \
+        }                                                                     \
+                                                                              \
+        T* tmp = strictAlloc(len * sizeof(T));                                \
+        T *src = items, *dst = tmp;                                           \
+        u64 first = keyOf(items[0]);                                          \
+                                                                              \
+        for (usize pass = 0; pass < 8; pass++) {                              \
+            usize shift = pass * 8;                                           \
+            if (count[pass][(first >> shift) & 0xff] == len) continue;        \
+                                                                              \
+            usize offset = 0;                                                 \
+            for (usize d = 0; d < 256; d++) {                                 \
+                usize n = count[pass][d];                                     \
+                count[pass][d] = offset;                                      \
+                offset += n;                                                  \
+            }                                                                 \
+            for (usize i = 0; i < len; i++)                                   \
+                dst[count[pass][(keyOf(src[i]) >> shift) & 0xff]++] = src[i]; \
+                                                                              \
+            T* swap = src;                                                    \
+            src = dst;                                                        \
+            dst = swap;                                                       \
+        }                                                                     \
+                                                                              \
+        if (src != items) memcpy(items, src, len * sizeof(T));                \
+        free(tmp);                                                            \
+    }
+
+#define DEFINE_BOUNDS(name, T, less)                                         \
+    static inline usize lowerBound##name(const T* items, usize len, T value) \
+    {                                                                        \
+        if (len == 0) return 0;                                              \
+        const T* base = items;                                               \
+        while (len > 1) {                                                    \
+            usize half = len / 2;                                            \
+            base = less(base[half - 1], value) ? base + half : base;         \
+            len -= half;                                                     \
+        }                                                                    \
+        return (usize)(base - items) + (less(*base, value) ? 1 : 0);         \
+    }                                                                        \
+                                                                             \
+    static inline usize upperBound##name(const T* items, usize len, T value) \
+    {                                                                        \
+        if (len == 0) return 0;                                              \
+        const T* base = items;                                               \
+        while (len > 1) {                                                    \
+            usize half = len / 2;                                            \
+            base = !less(value, base[half - 1]) ? base + half : base;        \
+            len -= half;                                                     \
+        }                                                                    \
+        return (usize)(base - items) + (!less(value, *base) ? 1 : 0);        \
+    }
+
 #define Slice(T)        \
     struct {            \
         const T* items; \
@@ -473,80 +1862,315 @@ typedef Slice(char) StringView;
 
 #define initSliceFromArray(slice, array, begin, end) initSlice(slice, (array)->items, (array)->len, begin, end)
 
+/*
+
+Delimiter set, a set of bytes compiled once and reused.
+
+The functions that take a `const char* delims` compile it into a set
+on every call, when splitting or trimming in a loop, compile the set
+once with initDelimSet() and use the Set variants instead.
+A byte is tested with one table lookup, and on x86-64 with SSSE3 or
+AVX2, 16 or 32 bytes are classified at once.
+
+API:
+DelimSet initDelimSet(const char* delims);
+    Compile every byte of the null terminated @delims into a set.
+
+bool isInDelimSet(const DelimSet* set, char c);
+    Test a single byte.
+
+bool splitSvBySet(StringView* sv, const DelimSet* set, StringView* out);
+StringView trimStartSvBySet(StringView* sv, const DelimSet* set);
+StringView trimEndSvBySet(StringView* sv, const DelimSet* set);
+StringView trimSvBySet(StringView* sv, const DelimSet* set);
+    Same as splitSvBy(), trimStartSvBy(), trimEndSvBy() and trimSvBy().
+
+*/
+
+typedef struct {
+    // Bit (c & 7) of bits[c >> 3] is set if c is in the set.
+    u8 bits[32];
+
+    // Same set for SIMD, indexed by the low nibble, bit (high nibble & 7)
+    // of the first table for high nibble 0-7, the second for 8-15.
+    u8 nibbles[2][16];
+} DelimSet;
+
+static inline bool isInDelimSet(const DelimSet* set, char c)
+{
+    return (set->bits[(u8)c >> 3] >> ((u8)c & 7)) & 1;
+}
+
 #define stringFmt(s) (int)(s).len, (s).items
 StringView initSvFrom(const char* cstr, usize begin, usize end);
 StringView initSvFromString(String* string, usize begin, usize end);
+DelimSet initDelimSet(const char* delims);
 bool splitSvBy(StringView* sv, const char* delims, StringView* out);
+bool splitSvBySet(StringView* sv, const DelimSet* set, StringView* out);
 StringView trimStartSvBy(StringView* sv, const char* delims);
+StringView trimStartSvBySet(StringView* sv, const DelimSet* set);
 StringView trimEndSvBy(StringView* sv, const char* delims);
+StringView trimEndSvBySet(StringView* sv, const DelimSet* set);
 StringView trimSvBy(StringView* sv, const char* delims);
+StringView trimSvBySet(StringView* sv, const DelimSet* set);
+/*
+Case conversion is ASCII only, every byte outside A-Z and a-z is kept
+as is, so it is safe on UTF-8. It converts 16 or 32 bytes at once with
+SSE2 or AVX2. The Locale variants go through toupper() and tolower()
+of the current C locale, one byte at a time.
+
+The IgnoreCase functions compare the ASCII letters without their case.
+compareSvIgnoreCase() returns a negative number, zero, or a positive
+number like memcmp(). hashSvIgnoreCase() is initFNV() of the lowercased
+bytes, so equal views ignoring case get the same hash.
+*/
 void toStringUppercase(String* string);
 void toStringLowercase(String* string);
+void toStringUppercaseLocale(String* string);
+void toStringLowercaseLocale(String* string);
+bool equalSvIgnoreCase(StringView* a, StringView* b);
+int compareSvIgnoreCase(StringView* a, StringView* b);
+u64 hashSvIgnoreCase(StringView* sv);
 String stringPrintf(const char* fmt, ...);
+String stringPrintfWith(Allocator* allocator, const char* fmt, ...);
 String readStreamToString(FILE* file);
+String readStreamToStringWith(Allocator* allocator, FILE* file);
 String readFileToString(const char* path);
+String readFileToStringWith(Allocator* allocator, const char* path);
 char* cstrArenaPrintf(Arena* arena, const char* fmt, ...);
 char* cstrPrintf(const char* fmt, ...);
 
-#ifdef MISC_IMPL
+/*
+String builder, the append functions grow @string geometrically with
+growCapacity() and keep items[len] zero, so items is always a valid C
+string after any of them.
 
-static bool isDelimsMatch(char target, const char* delims)
-{
-    for (usize i = 0; i < strlen(delims); i++) {
-        if (delims[i] == target)
-            return true;
-    }
-    return false;
-}
+appendPrintfToString() formats straight into the spare capacity, and
+only formats again after growing when the output didn't fit. The printf
+functions above are built on the same idea, cstrArenaPrintf() formats
+into the free tail of the current arena chunk before claiming it.
 
-StringView trimStartSvBy(StringView* sv, const char* delims)
-{
-    StringView result = {0};
-    if (sv->len < 1) return result;
+API:
+void appendBytesToString(String* string, const void* bytes, usize len);
+void appendCharToString(String* string, char c);
+void appendSvToString(String* string, StringView* sv);
+void appendCstrToString(String* string, const char* cstr);
+void appendPrintfToString(String* string, const char* fmt, ...);
+*/
+void appendBytesToString(String* string, const void* bytes, usize len);
+void appendCharToString(String* string, char c);
+void appendSvToString(String* string, StringView* sv);
+void appendCstrToString(String* string, const char* cstr);
+void appendPrintfToString(String* string, const char* fmt, ...);
 
-    usize i = 0;
-    while (i < sv->len && isDelimsMatch(sv->items[i], delims))
-        i++;
+/*
+mapFileToSv() maps the file read-only and returns a view over it,
+nothing is copied, the pages are read when they are first touched.
+@advice tells the kernel how the view is going to be walked, it is one
+of MISC_ADVISE_SEQUENTIAL or MISC_ADVISE_RANDOM optionally or'ed with
+MISC_ADVISE_WILLNEED to start reading ahead right away.
+
+The view is empty when the file can't be opened or is empty, it must be
+released with unmapSv(). Without mmap the file is read into the heap
+instead, unmapSv() frees it.
+*/
+#define MISC_ADVISE_NORMAL     0
+#define MISC_ADVISE_SEQUENTIAL 1
+#define MISC_ADVISE_RANDOM     2
+#define MISC_ADVISE_WILLNEED   4
 
-    result.items = sv->items + i;
-    result.len = sv->len - i;
-    return result;
-}
+StringView mapFileToSv(const char* path, int advice);
+void unmapSv(StringView* sv);
 
-StringView trimEndSvBy(StringView* sv, const char* delims)
-{
-    StringView result = {0};
-    if (sv->len < 1) return result;
+/*
+StreamReader reads a FILE* block by block into a fixed buffer and hands
+out lines or tokens as views into it, so pipes and stdin of any length
+are processed in constant memory. A view is only valid until the next
+read from the same reader. The part of a line or token cut by the end
+of a block is moved to the front of the buffer before the next block is
+read, nothing else is copied. The buffer only grows when a single line
+or token doesn't fit in it.
 
-    usize i = sv->len - 1;
-    while (i > 0 && isDelimsMatch(sv->items[i], delims))
-        i--;
+API:
 
-    result.items = sv->items;
-    if (i == 0)
-        result.len = 0;
-    else
-        result.len = i + 1;
+StreamReader initStreamReader(FILE* file, usize size);
+StreamReader initStreamReaderWith(Allocator* allocator, FILE* file, usize size);
+    The buffer holds @size bytes, zero means MISC_STREAM_BUFFER. The
+    reader doesn't own @file.
+
+bool readLineFromStream(StreamReader* reader, StringView* line);
+    Set @line to the next line without its '\n', the last line doesn't
+    need one. Returns false at the end of the stream.
+
+bool readTokenFromStream(StreamReader* reader, const DelimSet* set, StringView* token);
+    Set @token to the next run of bytes not in @set, skipping the
+    delimiters around it. Returns false at the end of the stream.
+
+void freeStreamReader(StreamReader* reader);
+*/
+
+#ifndef MISC_STREAM_BUFFER
+#define MISC_STREAM_BUFFER (64 * 1024)
+#endif
+
+typedef struct {
+    FILE*  file;
+    String buffer;
+    usize  begin; // First byte not handed out yet.
+    bool   eof;
+} StreamReader;
+
+StreamReader initStreamReader(FILE* file, usize size);
+StreamReader initStreamReaderWith(Allocator* allocator, FILE* file, usize size);
+bool readLineFromStream(StreamReader* reader, StringView* line);
+bool readTokenFromStream(StreamReader* reader, const DelimSet* set, StringView* token);
+void freeStreamReader(StreamReader* reader);
+
+#ifdef MISC_IMPL
+
+DelimSet initDelimSet(const char* delims)
+{
+    DelimSet set = {0};
+    if (delims == NULL) return set;
+
+    for (const u8* c = (const u8*)delims; *c != 0; c++) {
+        set.bits[*c >> 3] |= (u8)(1 << (*c & 7));
+        set.nibbles[*c >> 7][*c & 0x0f] |= (u8)(1 << ((*c >> 4) & 7));
+    }
+    return set;
+}
+
+/*
+Classify a block of bytes against the set, bit i of the mask is set if
+byte i is in the set. The low nibble picks a row of the nibble table,
+the high nibble picks the bit of that row.
+*/
+#if defined(MISC_AVX2)
+#define MISC_DELIM_BLOCK (32)
+static inline u32 classifyDelimSet(const DelimSet* set, const u8* p)
+{
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    const __m256i rows0 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)set->nibbles[0]));
+    const __m256i rows1 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)set->nibbles[1]));
+    const __m256i bits = _mm256_setr_epi8(
+        1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+        1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    __m256i lo = _mm256_and_si256(v, nibble);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+    __m256i row = _mm256_blendv_epi8(
+        _mm256_shuffle_epi8(rows0, lo),
+        _mm256_shuffle_epi8(rows1, lo),
+        _mm256_cmpgt_epi8(hi, _mm256_set1_epi8(7)));
+    __m256i bit = _mm256_shuffle_epi8(bits, hi);
+    __m256i hit = _mm256_cmpeq_epi8(_mm256_and_si256(row, bit), bit);
+    return (u32)_mm256_movemask_epi8(hit);
+}
+#elif defined(MISC_SSSE3)
+#define MISC_DELIM_BLOCK (16)
+static inline u32 classifyDelimSet(const DelimSet* set, const u8* p)
+{
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    const __m128i rows0 = _mm_loadu_si128((const __m128i*)set->nibbles[0]);
+    const __m128i rows1 = _mm_loadu_si128((const __m128i*)set->nibbles[1]);
+    const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i lo = _mm_and_si128(v, nibble);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+    __m128i high = _mm_cmpgt_epi8(hi, _mm_set1_epi8(7));
+    __m128i row = _mm_or_si128(
+        _mm_andnot_si128(high, _mm_shuffle_epi8(rows0, lo)),
+        _mm_and_si128(high, _mm_shuffle_epi8(rows1, lo)));
+    __m128i bit = _mm_shuffle_epi8(bits, hi);
+    __m128i hit = _mm_cmpeq_epi8(_mm_and_si128(row, bit), bit);
+    return (u32)_mm_movemask_epi8(hit);
+}
+#endif
+
+// Index of the first byte that is (or is not, if !@inSet) in @set.
+static usize scanDelimSet(
+    const DelimSet* set,
+    const char*     str,
+    usize           len,
+    bool            inSet)
+{
+    const u8* p = (const u8*)str;
+    usize i = 0;
+
+#ifdef MISC_DELIM_BLOCK
+    const u32 full = (u32)(((u64)1 << MISC_DELIM_BLOCK) - 1);
+    for (; i + MISC_DELIM_BLOCK <= len; i += MISC_DELIM_BLOCK) {
+        u32 mask = classifyDelimSet(set, p + i);
+        if (!inSet) mask = ~mask & full;
+        if (mask != 0) return i + (usize)__builtin_ctz(mask);
+    }
+#endif
+
+    while (i < len && isInDelimSet(set, p[i]) != inSet)
+        i++;
+    return i;
+}
+
+// One past the last byte that is (or is not, if !@inSet) in @set.
+static usize scanDelimSetBack(
+    const DelimSet* set,
+    const char*     str,
+    usize           len,
+    bool            inSet)
+{
+    const u8* p = (const u8*)str;
+
+#ifdef MISC_DELIM_BLOCK
+    const u32 full = (u32)(((u64)1 << MISC_DELIM_BLOCK) - 1);
+    for (; len >= MISC_DELIM_BLOCK; len -= MISC_DELIM_BLOCK) {
+        u32 mask = classifyDelimSet(set, p + len - MISC_DELIM_BLOCK);
+        if (!inSet) mask = ~mask & full;
+        if (mask != 0) return len - MISC_DELIM_BLOCK + (usize)(32 - __builtin_clz(mask));
+    }
+#endif
+
+    while (len > 0 && isInDelimSet(set, p[len - 1]) != inSet)
+        len--;
+    return len;
+}
+
+StringView trimStartSvBySet(StringView* sv, const DelimSet* set)
+{
+    StringView result = {0};
+    if (sv->len < 1) return result;
+
+    usize i = scanDelimSet(set, sv->items, sv->len, false);
+    result.items = sv->items + i;
+    result.len = sv->len - i;
     return result;
 }
 
-StringView trimSvBy(StringView* sv, const char* delims)
+StringView trimEndSvBySet(StringView* sv, const DelimSet* set)
+{
+    StringView result = {0};
+    if (sv->len < 1) return result;
+
+    result.items = sv->items;
+    result.len = scanDelimSetBack(set, sv->items, sv->len, false);
+    return result;
+}
+
+StringView trimSvBySet(StringView* sv, const DelimSet* set)
 {
-    StringView result = trimStartSvBy(sv, delims);
-    return trimEndSvBy(&result, delims);
+    StringView result = trimStartSvBySet(sv, set);
+    return trimEndSvBySet(&result, set);
 }
 
-bool splitSvBy(
-    StringView* sv,
-    const char* delims,
-    StringView* out)
+bool splitSvBySet(
+    StringView*     sv,
+    const DelimSet* set,
+    StringView*     out)
 {
     if (sv->len == 0) return false;
 
-    usize i = 0;
-    while (i < sv->len && !isDelimsMatch(sv->items[i], delims))
-        i += 1;
-
+    usize i = scanDelimSet(set, sv->items, sv->len, true);
     StringView result = {
         .items = sv->items,
         .len = i,
@@ -564,6 +2188,33 @@ bool splitSvBy(
     return true;
 }
 
+StringView trimStartSvBy(StringView* sv, const char* delims)
+{
+    DelimSet set = initDelimSet(delims);
+    return trimStartSvBySet(sv, &set);
+}
+
+StringView trimEndSvBy(StringView* sv, const char* delims)
+{
+    DelimSet set = initDelimSet(delims);
+    return trimEndSvBySet(sv, &set);
+}
+
+StringView trimSvBy(StringView* sv, const char* delims)
+{
+    DelimSet set = initDelimSet(delims);
+    return trimSvBySet(sv, &set);
+}
+
+bool splitSvBy(
+    StringView* sv,
+    const char* delims,
+    StringView* out)
+{
+    DelimSet set = initDelimSet(delims);
+    return splitSvBySet(sv, &set, out);
+}
+
 StringView initSvFrom(
     const char* cstr,
     usize       begin,
@@ -578,120 +2229,1938 @@ StringView initSvFrom(
     return ref;
 }
 
+/*
+Flip the case of every byte in @first..@first + 25, so 'a' turns
+lowercase into uppercase, and 'A' the other way around. The range test
+is done with one signed compare, by moving @first into -128.
+*/
+#if defined(MISC_AVX2)
+static inline __m256i flipCase256(__m256i v, char first)
+{
+    __m256i shifted = _mm256_add_epi8(v, _mm256_set1_epi8((char)(0x80 - first)));
+    __m256i letter = _mm256_cmpgt_epi8(_mm256_set1_epi8(-128 + 26), shifted);
+    return _mm256_xor_si256(v, _mm256_and_si256(letter, _mm256_set1_epi8(0x20)));
+}
+#endif
+
+#if defined(MISC_SSE2)
+static inline __m128i flipCase128(__m128i v, char first)
+{
+    __m128i shifted = _mm_add_epi8(v, _mm_set1_epi8((char)(0x80 - first)));
+    __m128i letter = _mm_cmplt_epi8(shifted, _mm_set1_epi8(-128 + 26));
+    return _mm_xor_si128(v, _mm_and_si128(letter, _mm_set1_epi8(0x20)));
+}
+#endif
+
+#define flipCase(c, first) ((u8)((u8)(c) - (u8)(first)) < 26 ? (u8)(c) ^ 0x20 : (u8)(c))
+
+static void convertAsciiCase(
+    u8*       dst,
+    const u8* src,
+    usize     len,
+    char      first)
+{
+    usize i = 0;
+#if defined(MISC_AVX2)
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), flipCase256(v, first));
+    }
+#endif
+#if defined(MISC_SSE2)
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + i), flipCase128(v, first));
+    }
+#endif
+    for (; i < len; i++)
+        dst[i] = flipCase(src[i], first);
+}
+
+// Index of the first byte that differ between @a and @b ignoring case.
+static usize mismatchIgnoreCase(const u8* a, const u8* b, usize len)
+{
+    usize i = 0;
+#if defined(MISC_AVX2)
+    for (; i + 32 <= len; i += 32) {
+        __m256i x = flipCase256(_mm256_loadu_si256((const __m256i*)(a + i)), 'A');
+        __m256i y = flipCase256(_mm256_loadu_si256((const __m256i*)(b + i)), 'A');
+        u32 same = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y));
+        if (same != 0xffffffffu) return i + (usize)__builtin_ctz(~same);
+    }
+#endif
+#if defined(MISC_SSE2)
+    for (; i + 16 <= len; i += 16) {
+        __m128i x = flipCase128(_mm_loadu_si128((const __m128i*)(a + i)), 'A');
+        __m128i y = flipCase128(_mm_loadu_si128((const __m128i*)(b + i)), 'A');
+        u32 same = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(x, y));
+        if (same != 0xffffu) return i + (usize)__builtin_ctz(~same);
+    }
+#endif
+    while (i < len && flipCase(a[i], 'A') == flipCase(b[i], 'A'))
+        i++;
+    return i;
+}
+
 void toStringUppercase(String* string)
+{
+    u8* bytes = (u8*)string->items;
+    convertAsciiCase(bytes, bytes, string->len, 'a');
+}
+
+void toStringLowercase(String* string)
+{
+    u8* bytes = (u8*)string->items;
+    convertAsciiCase(bytes, bytes, string->len, 'A');
+}
+
+void toStringUppercaseLocale(String* string)
 {
     for (usize i = 0; i < string->len; i++) {
-        if (islower(string->items[i]))
-            string->items[i] = toupper(string->items[i]);
+        if (islower((u8)string->items[i]))
+            string->items[i] = toupper((u8)string->items[i]);
     }
 }
 
-void toStringLowercase(String* string)
+void toStringLowercaseLocale(String* string)
+{
+    for (usize i = 0; i < string->len; i++) {
+        if (isupper((u8)string->items[i]))
+            string->items[i] = tolower((u8)string->items[i]);
+    }
+}
+
+bool equalSvIgnoreCase(StringView* a, StringView* b)
+{
+    if (a->len != b->len) return false;
+    return mismatchIgnoreCase((const u8*)a->items, (const u8*)b->items, a->len) == a->len;
+}
+
+int compareSvIgnoreCase(StringView* a, StringView* b)
 {
-    for (usize i = 0; i < string->len; i++) 
-        if (isupper(string->items[i]))
-            string->items[i] = tolower(string->items[i]);
-    
+    usize len = a->len < b->len ? a->len : b->len;
+    usize i = mismatchIgnoreCase((const u8*)a->items, (const u8*)b->items, len);
+
+    if (i < len)
+        return (int)flipCase(a->items[i], 'A') - (int)flipCase(b->items[i], 'A');
+    return (a->len > b->len) - (a->len < b->len);
 }
 
 String readStreamToString(FILE* file)
 {
-    String string = {0};
+    return readStreamToStringWith(NULL, file);
+}
+
+String readStreamToStringWith(Allocator* allocator, FILE* file)
+{
+    String string = { .allocator = allocator };
     if (feof(file))
         return string;
 
+    /*
+    The size is only a hint, pipes can't seek and some files lie. One
+    byte more than the file and the terminator, so the read that meets
+    the end is short and nothing grows after the whole file is in.
+    */
     long pos;
-    if (fseek(file, 0, SEEK_END) != 0) return string;
-    if ((pos = ftell(file)) <= 0) return string;
+    usize hint = MISC_STREAM_BUFFER;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        if ((pos = ftell(file)) > 0) hint = (usize)pos + 2;
+        rewind(file);
+    }
 
-    rewind(file);
-    resizeArray(&string, (usize)pos + 1);
-    fread(string.items, 1, string.cap, file);
-    string.len = (usize)pos;
+    reserveArray(&string, hint);
+    for (;;) {
+        if (string.cap - string.len < 2)
+            resizeArray(&string, growCapacity(string.cap, string.len + 2));
+
+        // A short read is the end of the file or an error, stop before growing again.
+        usize want = string.cap - string.len - 1;
+        usize n = fread(string.items + string.len, 1, want, file);
+        string.len += n;
+        if (n < want) break;
+    }
+
+    string.items[string.len] = '\0';
     return string;
 }
 
 String readFileToString(const char* path)
 {
-    String result = {0};
+    return readFileToStringWith(NULL, path);
+}
+
+String readFileToStringWith(Allocator* allocator, const char* path)
+{
+    String result = { .allocator = allocator };
     FILE* file = fopen(path, "r");
     if (file != NULL) {
-        result = readStreamToString(file);
+        result = readStreamToStringWith(allocator, file);
         fclose(file);
     }
     return result;
 }
 
+StringView mapFileToSv(const char* path, int advice)
+{
+    StringView sv = {0};
+#ifdef MISC_HAS_MMAN
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return sv;
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        usize size = (usize)info.st_size;
+        void* base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (base != MAP_FAILED) {
+            if (advice & MISC_ADVISE_SEQUENTIAL) madvise(base, size, MADV_SEQUENTIAL);
+            if (advice & MISC_ADVISE_RANDOM) madvise(base, size, MADV_RANDOM);
+            if (advice & MISC_ADVISE_WILLNEED) madvise(base, size, MADV_WILLNEED);
+            sv.items = base;
+            sv.len = size;
+        }
+    }
+
+    // The mapping keeps its own reference to the file.
+    close(fd);
+#else
+    (void)advice;
+    String string = readFileToString(path);
+    sv.items = string.items;
+    sv.len = string.len;
+#endif
+    return sv;
+}
+
+void unmapSv(StringView* sv)
+{
+    if (sv->items == NULL) return;
+#ifdef MISC_HAS_MMAN
+    munmap((void*)sv->items, sv->len);
+#else
+    free((void*)sv->items);
+#endif
+    sv->items = NULL;
+    sv->len = 0;
+}
+
+StreamReader initStreamReader(FILE* file, usize size)
+{
+    return initStreamReaderWith(NULL, file, size);
+}
+
+StreamReader initStreamReaderWith(
+    Allocator* allocator,
+    FILE*      file,
+    usize      size)
+{
+    StreamReader reader = { .file = file };
+    reader.buffer.allocator = allocator;
+    resizeArray(&reader.buffer, size > 0 ? size : MISC_STREAM_BUFFER);
+    return reader;
+}
+
+/*
+Move what is left after @begin to the front and read the next block
+behind it, the buffer grows only when it is full already. Returns false
+when nothing more could be read.
+*/
+static bool refillStreamReader(StreamReader* reader)
+{
+    String* buffer = &reader->buffer;
+    if (reader->eof) return false;
+
+    if (reader->begin > 0) {
+        buffer->len -= reader->begin;
+        memmove(buffer->items, buffer->items + reader->begin, buffer->len);
+        reader->begin = 0;
+    }
+
+    if (buffer->len == buffer->cap)
+        resizeArray(buffer, growCapacity(buffer->cap, buffer->len + 1));
+
+    usize n = fread(buffer->items + buffer->len, 1, buffer->cap - buffer->len, reader->file);
+    buffer->len += n;
+    if (n == 0) reader->eof = true;
+    return n > 0;
+}
+
+bool readLineFromStream(StreamReader* reader, StringView* line)
+{
+    usize scanned = 0;
+    for (;;) {
+        String* buffer = &reader->buffer;
+        char* begin = buffer->items + reader->begin;
+        usize left = buffer->len - reader->begin;
+        char* newline = memchr(begin + scanned, '\n', left - scanned);
+
+        if (newline != NULL) {
+            line->items = begin;
+            line->len = (usize)(newline - begin);
+            reader->begin += line->len + 1;
+            return true;
+        }
+
+        scanned = left;
+        if (!refillStreamReader(reader)) {
+            if (left == 0) return false;
+            line->items = buffer->items + reader->begin;
+            line->len = left;
+            reader->begin += left;
+            return true;
+        }
+    }
+}
+
+bool readTokenFromStream(
+    StreamReader*   reader,
+    const DelimSet* set,
+    StringView*     token)
+{
+    String* buffer = &reader->buffer;
+
+    // Drop the delimiters first so they are never carried over.
+    for (;;) {
+        usize left = buffer->len - reader->begin;
+        reader->begin += scanDelimSet(set, buffer->items + reader->begin, left, false);
+        if (reader->begin < buffer->len) break;
+        if (!refillStreamReader(reader)) return false;
+    }
+
+    usize scanned = 0;
+    for (;;) {
+        char* begin = buffer->items + reader->begin;
+        usize left = buffer->len - reader->begin;
+        scanned += scanDelimSet(set, begin + scanned, left - scanned, true);
+
+        if (scanned < left || !refillStreamReader(reader)) {
+            token->items = buffer->items + reader->begin;
+            token->len = scanned;
+            reader->begin += scanned;
+            return true;
+        }
+    }
+}
+
+void freeStreamReader(StreamReader* reader)
+{
+    freeArray(&reader->buffer);
+    reader->begin = 0;
+}
+
 StringView initSvFromString(
     String* str,
     usize   begin,
     usize   end)
 {
-    StringView ref = {0};
-    initSliceFromArray(&ref, str, begin, end);
-    return ref;
+    StringView ref = {0};
+    initSliceFromArray(&ref, str, begin, end);
+    return ref;
+}
+
+// Make room for @extra bytes and the null terminator.
+static void growString(String* string, usize extra)
+{
+    if (string->cap - string->len <= extra)
+        resizeArray(string, growCapacity(string->cap, string->len + extra + 1));
+}
+
+void appendBytesToString(
+    String*     string,
+    const void* bytes,
+    usize       len)
+{
+    growString(string, len);
+    if (len > 0) memcpy(string->items + string->len, bytes, len);
+    string->len += len;
+    string->items[string->len] = '\0';
+}
+
+void appendCharToString(String* string, char c)
+{
+    growString(string, 1);
+    string->items[string->len++] = c;
+    string->items[string->len] = '\0';
+}
+
+void appendSvToString(String* string, StringView* sv)
+{
+    appendBytesToString(string, sv->items, sv->len);
+}
+
+void appendCstrToString(String* string, const char* cstr)
+{
+    appendBytesToString(string, cstr, strlen(cstr));
+}
+
+static void vappendPrintfToString(
+    String*     string,
+    const char* fmt,
+    va_list     va)
+{
+    va_list copy;
+    va_copy(copy, va);
+
+    // Always give vsnprintf() some room, so short output is done in one go.
+    growString(string, MISC_ARRAY_RESERVE);
+    usize spare = string->cap - string->len;
+    int size = vsnprintf(string->items + string->len, spare, fmt, copy);
+    va_end(copy);
+
+    if (size < 0) {
+        string->items[string->len] = '\0';
+        return;
+    }
+
+    if ((usize)size >= spare) {
+        growString(string, (usize)size);
+        vsnprintf(string->items + string->len, (usize)size + 1, fmt, va);
+    }
+    string->len += (usize)size;
+}
+
+void appendPrintfToString(
+    String*     string,
+    const char* fmt,
+                ...)
+{
+    va_list va;
+    va_start(va, fmt);
+    vappendPrintfToString(string, fmt, va);
+    va_end(va);
+}
+
+char* cstrArenaPrintf(
+    Arena*      arena,
+    const char* fmt,
+                ...)
+{
+    va_list va;
+    char* buf = NULL;
+    char* tail = NULL;
+    usize room = 0;
+    int size = 0;
+
+    /*
+    Format into the free tail of the current chunk first, if it fits,
+    allocArena() hands out that very same place, so there is nothing to
+    copy. Shared arena could be bumped by another thread meanwhile.
+    */
+    if (arena != NULL && !arena->shared) {
+        ArenaBody* body = valueOfNodeLink(arena->last);
+        usize align = arena->align < MISC_ALIGN ? MISC_ALIGN : arena->align;
+        usize start = body->len + alignPadding((u8*)body + sizeof *body + body->len, align);
+        usize end = body->cap;
+        if (arena->reserved != 0 && arena->committed - arenaHeader < end)
+            end = arena->committed - arenaHeader;
+
+        if (start < end) {
+            tail = (char*)body + sizeof *body + start;
+            room = end - start;
+        }
+    }
+
+    va_start(va, fmt);
+    size = vsnprintf(tail, room, fmt, va);
+    va_end(va);
+
+    if (size > 0) {
+        buf = allocArena(arena, (usize)size + 1);
+        if (buf != NULL && (buf != tail || (usize)size >= room)) {
+            va_start(va, fmt);
+            vsnprintf(buf, (usize)size + 1, fmt, va);
+            va_end(va);
+        }
+    }
+
+    return buf;
+}
+
+char* cstrPrintf(const char* fmt, ...)
+{
+    va_list va;
+    char stack[256];
+    char* buf = NULL;
+    int size = 0;
+
+    va_start(va, fmt);
+    size = vsnprintf(stack, sizeof stack, fmt, va);
+    va_end(va);
+
+    if (size > 0) {
+        buf = strictAlloc((usize)size + 1);
+        if ((usize)size < sizeof stack) {
+            memcpy(buf, stack, (usize)size + 1);
+        } else {
+            va_start(va, fmt);
+            vsnprintf(buf, (usize)size + 1, fmt, va);
+            va_end(va);
+        }
+    }
+
+    return buf;
+}
+
+static String vstringPrintf(
+    Allocator*  allocator,
+    const char* fmt,
+    va_list     va)
+{
+    String str = { .allocator = allocator };
+    vappendPrintfToString(&str, fmt, va);
+    return str;
+}
+
+String stringPrintf(const char* fmt, ...)
+{
+    va_list va;
+    va_start(va, fmt);
+    String str = vstringPrintf(NULL, fmt, va);
+    va_end(va);
+    return str;
+}
+
+String stringPrintfWith(
+    Allocator*  allocator,
+    const char* fmt,
+                ...)
+{
+    va_list va;
+    va_start(va, fmt);
+    String str = vstringPrintf(allocator, fmt, va);
+    va_end(va);
+    return str;
+}
+#endif
+
+/*
+
+Numbers, parse and format without allocating or needing a null terminator.
+
+The parsers read a number from the start of @sv, leading spaces are not
+skipped, and store how many bytes it took in @consumed, which can be
+null. They return MISC_PARSE_OK, MISC_PARSE_INVALID when @sv doesn't
+start with a number (@consumed is zero), or MISC_PARSE_RANGE when it
+doesn't fit, then @value is clamped to the nearest end of the range,
+or to an infinity for floats.
+
+parseF64FromSv() accepts the strtod() decimal syntax, `inf`, `infinity`
+and `nan` in any case, but not hex floats. It is exact when the digits
+fit in 53 bits and the power of ten is small, which is most numbers in
+practice, the rest go through strtod() on a canonical copy of the
+digits on the stack, so it doesn't depend on the locale either.
+
+The format functions write at most MISC_NUMBER_CHARS bytes into @buf,
+without a null terminator, and return the length. formatF64() prints
+the shortest digits that read back as the same double (Grisu2, which is
+the shortest one in all but very rare cases), without an exponent when
+the decimal point is close enough.
+
+API:
+int parseU64FromSv(StringView* sv, u64* value, usize* consumed);
+int parseI64FromSv(StringView* sv, i64* value, usize* consumed);
+int parseF64FromSv(StringView* sv, f64* value, usize* consumed);
+usize formatU64(u64 value, char* buf);
+usize formatI64(i64 value, char* buf);
+usize formatF64(f64 value, char* buf);
+void appendU64ToString(String* string, u64 value);
+void appendI64ToString(String* string, i64 value);
+void appendF64ToString(String* string, f64 value);
+
+*/
+
+#define MISC_PARSE_OK      0
+#define MISC_PARSE_INVALID 1
+#define MISC_PARSE_RANGE   2
+
+#define MISC_NUMBER_CHARS (32)
+
+int parseU64FromSv(StringView* sv, u64* value, usize* consumed);
+int parseI64FromSv(StringView* sv, i64* value, usize* consumed);
+int parseF64FromSv(StringView* sv, f64* value, usize* consumed);
+usize formatU64(u64 value, char* buf);
+usize formatI64(i64 value, char* buf);
+usize formatF64(f64 value, char* buf);
+void appendU64ToString(String* string, u64 value);
+void appendI64ToString(String* string, i64 value);
+void appendF64ToString(String* string, f64 value);
+
+#ifdef MISC_IMPL
+#define isDigit(c) ((u8)((c) - '0') < 10)
+
+// Parse the digits after an optional sign, @i is where the digits start.
+static int parseDigits(
+    StringView* sv,
+    usize       i,
+    u64*        value,
+    usize*      consumed)
+{
+    usize begin = i;
+    u64 result = 0;
+    bool overflow = false;
+
+    for (; i < sv->len && isDigit(sv->items[i]); i++) {
+        u64 digit = (u64)(sv->items[i] - '0');
+        if (result > (UINT64_MAX - digit) / 10) overflow = true;
+        result = result * 10 + digit;
+    }
+
+    if (i == begin) {
+        *value = 0;
+        if (consumed != NULL) *consumed = 0;
+        return MISC_PARSE_INVALID;
+    }
+
+    *value = overflow ? UINT64_MAX : result;
+    if (consumed != NULL) *consumed = i;
+    return overflow ? MISC_PARSE_RANGE : MISC_PARSE_OK;
+}
+
+int parseU64FromSv(
+    StringView* sv,
+    u64*        value,
+    usize*      consumed)
+{
+    usize i = sv->len > 0 && sv->items[0] == '+';
+    return parseDigits(sv, i, value, consumed);
+}
+
+int parseI64FromSv(
+    StringView* sv,
+    i64*        value,
+    usize*      consumed)
+{
+    bool negative = sv->len > 0 && sv->items[0] == '-';
+    usize i = sv->len > 0 && (negative || sv->items[0] == '+');
+
+    u64 magnitude;
+    int status = parseDigits(sv, i, &magnitude, consumed);
+    u64 limit = negative ? (u64)INT64_MAX + 1 : (u64)INT64_MAX;
+
+    if (status == MISC_PARSE_INVALID) {
+        *value = 0;
+        return status;
+    }
+    if (magnitude > limit) {
+        magnitude = limit;
+        status = MISC_PARSE_RANGE;
+    }
+
+    *value = negative ? (i64)(0 - magnitude) : (i64)magnitude;
+    return status;
+}
+
+// Match @word ignoring case at @i, returns its length or zero.
+static usize matchWordIgnoreCase(StringView* sv, usize i, const char* word)
+{
+    usize len = strlen(word);
+    if (sv->len - i < len) return 0;
+    for (usize j = 0; j < len; j++)
+        if ((sv->items[i + j] | 0x20) != word[j]) return 0;
+    return len;
+}
+
+// Past 768 significant digits a double can't change anymore.
+#define MISC_F64_DIGITS (768)
+
+int parseF64FromSv(
+    StringView* sv,
+    f64*        value,
+    usize*      consumed)
+{
+    static const f64 powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+
+    const char* s = sv->items;
+    usize len = sv->len, i = 0;
+    bool negative = len > 0 && s[0] == '-';
+    if (len > 0 && (negative || s[0] == '+')) i++;
+
+    usize word;
+    if ((word = matchWordIgnoreCase(sv, i, "inf")) > 0) {
+        usize rest = matchWordIgnoreCase(sv, i + word, "inity");
+        *value = negative ? -HUGE_VAL : HUGE_VAL;
+        if (consumed != NULL) *consumed = i + word + rest;
+        return MISC_PARSE_OK;
+    }
+    if ((word = matchWordIgnoreCase(sv, i, "nan")) > 0) {
+        *value = negative ? -NAN : NAN;
+        if (consumed != NULL) *consumed = i + word;
+        return MISC_PARSE_OK;
+    }
+
+    /*
+    Keep the first 19 significant digits in @mantissa, and remember where
+    the digits are for the slow path. @exponent is the power of ten of
+    the last digit kept.
+    */
+    u64 mantissa = 0;
+    usize digits = 0, significant = 0;
+    i64 exponent = 0;
+    usize begin = i;
+    bool dot = false;
+
+    for (; i < len; i++) {
+        if (s[i] == '.' && !dot) {
+            dot = true;
+            continue;
+        }
+        if (!isDigit(s[i])) break;
+
+        digits++;
+        if (significant == 0 && s[i] == '0') {
+            if (dot) exponent--;
+            continue;
+        }
+        if (significant < 19) {
+            mantissa = mantissa * 10 + (u64)(s[i] - '0');
+            if (dot) exponent--;
+        } else if (!dot) {
+            exponent++;
+        }
+        significant++;
+    }
+    usize end = i;
+
+    if (digits == 0) {
+        *value = 0;
+        if (consumed != NULL) *consumed = 0;
+        return MISC_PARSE_INVALID;
+    }
+
+    // The exponent only counts when it has at least one digit.
+    if (i < len && (s[i] == 'e' || s[i] == 'E')) {
+        usize j = i + 1;
+        bool expNegative = j < len && s[j] == '-';
+        if (j < len && (expNegative || s[j] == '+')) j++;
+
+        if (j < len && isDigit(s[j])) {
+            i64 e = 0;
+            for (; j < len && isDigit(s[j]); j++)
+                if (e < 100000) e = e * 10 + (s[j] - '0');
+            exponent += expNegative ? -e : e;
+            i = j;
+        }
+    }
+    if (consumed != NULL) *consumed = i;
+
+    f64 result;
+    if (mantissa == 0) {
+        result = 0;
+    } else if (significant <= 19 && mantissa <= ((u64)1 << 53) && exponent >= -22 && exponent <= 22) {
+        // Both operands are exact, so the only rounding is the last one.
+        result = (f64)mantissa;
+        result = exponent < 0 ? result / powers[-exponent] : result * powers[exponent];
+    } else {
+        /*
+        Write the significant digits as an integer with an exponent,
+        then the result can't depend on the decimal point of the locale.
+        Digits past MISC_F64_DIGITS only matter for being non zero.
+        */
+        char buf[MISC_F64_DIGITS + 32];
+        usize n = 0, kept = 0;
+        bool sticky = false;
+        bool seen = false;
+        i64 shift = 0;
+
+        for (usize j = begin; j < end; j++) {
+            if (s[j] == '.') continue;
+            if (!seen && s[j] == '0') continue;
+            seen = true;
+            if (kept < MISC_F64_DIGITS) {
+                buf[n++] = s[j];
+                kept++;
+            } else if (s[j] != '0') {
+                sticky = true;
+            }
+        }
+        if (sticky) buf[n++] = '1';
+
+        // The digits written stand for 10^(exponent of the last one).
+        shift = exponent - (i64)(n - (significant < 19 ? significant : 19));
+        snprintf(buf + n, sizeof buf - n, "e%" PRId64, shift);
+        result = strtod(buf, NULL);
+    }
+
+    *value = negative ? -result : result;
+    return isinf(result) ? MISC_PARSE_RANGE : MISC_PARSE_OK;
+}
+
+static const char digitPairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static usize countDigits(u64 value)
+{
+    usize n = 1;
+    for (;;) {
+        if (value < 10) return n;
+        if (value < 100) return n + 1;
+        if (value < 1000) return n + 2;
+        if (value < 10000) return n + 3;
+        value /= 10000;
+        n += 4;
+    }
+}
+
+usize formatU64(u64 value, char* buf)
+{
+    usize len = countDigits(value);
+    char* p = buf + len;
+
+    while (value >= 100) {
+        usize pair = (usize)(value % 100) * 2;
+        value /= 100;
+        *--p = digitPairs[pair + 1];
+        *--p = digitPairs[pair];
+    }
+
+    if (value >= 10) {
+        *--p = digitPairs[value * 2 + 1];
+        *--p = digitPairs[value * 2];
+    } else {
+        *--p = (char)('0' + value);
+    }
+    return len;
+}
+
+usize formatI64(i64 value, char* buf)
+{
+    if (value >= 0) return formatU64((u64)value, buf);
+    buf[0] = '-';
+    return formatU64(0 - (u64)value, buf + 1) + 1;
+}
+
+/*
+Grisu2 by Florian Loitsch, "Printing Floating-Point Numbers Quickly and
+Accurately with Integers", the layout follows the one from RapidJSON.
+A DiyFp is f * 2^e with a 64-bit f.
+*/
+typedef struct {
+    u64 f;
+    int e;
+} DiyFp;
+
+static DiyFp multiplyDiyFp(DiyFp a, DiyFp b)
+{
+    const u64 mask = 0xffffffffULL;
+    u64 ah = a.f >> 32, al = a.f & mask;
+    u64 bh = b.f >> 32, bl = b.f & mask;
+    u64 hh = ah * bh, hl = ah * bl, lh = al * bh, ll = al * bl;
+
+    // Round the dropped low half.
+    u64 mid = (ll >> 32) + (hl & mask) + (lh & mask) + (1ULL << 31);
+    DiyFp result = { hh + (hl >> 32) + (lh >> 32) + (mid >> 32), a.e + b.e + 64 };
+    return result;
+}
+
+static DiyFp normalizeDiyFp(DiyFp x)
+{
+    int shift = __builtin_clzll(x.f);
+    x.f <<= shift;
+    x.e -= shift;
+    return x;
+}
+
+// The cached power of ten c such that c * 2^e lands in [2^-60, 2^-32].
+static DiyFp cachedPowerOfTen(int e, int* k)
+{
+    static const u64 significands[] = {
+        0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL, 0xcf42894a5dce35eaULL,
+        0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL, 0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL,
+        0xbe5691ef416bd60cULL, 0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+        0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL, 0xc21094364dfb5637ULL,
+        0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL, 0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL,
+        0xb23867fb2a35b28eULL, 0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+        0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL, 0xb5b5ada8aaff80b8ULL,
+        0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL, 0x964e858c91ba2655ULL, 0xdff9772470297ebdULL,
+        0xa6dfbd9fb8e5b88fULL, 0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+        0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL, 0xaa242499697392d3ULL,
+        0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL, 0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL,
+        0x9c40000000000000ULL, 0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+        0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL, 0x9f4f2726179a2245ULL,
+        0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL, 0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL,
+        0x924d692ca61be758ULL, 0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+        0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL, 0x952ab45cfa97a0b3ULL,
+        0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL, 0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL,
+        0x88fcf317f22241e2ULL, 0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+        0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL, 0x8bab8eefb6409c1aULL,
+        0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL, 0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL,
+        0x80444b5e7aa7cf85ULL, 0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+        0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL,
+    };
+    static const i16 exponents[] = {
+        -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954,
+        -927, -901, -874, -847, -821, -794, -768, -741, -715, -688, -661,
+        -635, -608, -582, -555, -529, -502, -475, -449, -422, -396, -369,
+        -343, -316, -289, -263, -236, -210, -183, -157, -130, -103, -77,
+        -50, -24, 3, 30, 56, 83, 109, 136, 162, 189, 216,
+        242, 269, 295, 322, 348, 375, 402, 428, 455, 481, 508,
+        534, 561, 588, 614, 641, 667, 694, 720, 747, 774, 800,
+        827, 853, 880, 907, 933, 960, 986, 1013, 1039, 1066,
+    };
+
+    f64 dk = (-61 - e) * 0.30102999566398114 + 347;
+    int ki = (int)dk;
+    if (dk - ki > 0.0) ki++;
+
+    usize index = (usize)((ki >> 3) + 1);
+    *k = -(-348 + (int)index * 8);
+
+    DiyFp result = { significands[index], exponents[index] };
+    return result;
+}
+
+static void roundGrisu(
+    char* buf,
+    usize len,
+    u64   delta,
+    u64   rest,
+    u64   tenKappa,
+    u64   distance)
+{
+    while (rest < distance && delta - rest >= tenKappa &&
+           (rest + tenKappa < distance || distance - rest > rest + tenKappa - distance)) {
+        buf[len - 1]--;
+        rest += tenKappa;
+    }
+}
+
+static usize generateDigits(
+    DiyFp w,
+    DiyFp upper,
+    u64   delta,
+    char* buf,
+    int*  k)
+{
+    static const u64 powers[] = {
+        1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+        100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+        10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+        100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL,
+    };
+
+    DiyFp one = { 1ULL << -upper.e, upper.e };
+    u64 distance = upper.f - w.f;
+    u32 p1 = (u32)(upper.f >> -one.e);
+    u64 p2 = upper.f & (one.f - 1);
+    int kappa = (int)countDigits(p1);
+    usize len = 0;
+
+    while (kappa > 0) {
+        u32 d = p1 / (u32)powers[kappa - 1];
+        p1 %= (u32)powers[kappa - 1];
+        if (d != 0 || len != 0) buf[len++] = (char)('0' + d);
+        kappa--;
+
+        u64 rest = ((u64)p1 << -one.e) + p2;
+        if (rest <= delta) {
+            *k += kappa;
+            roundGrisu(buf, len, delta, rest, powers[kappa] << -one.e, distance);
+            return len;
+        }
+    }
+
+    for (;;) {
+        p2 *= 10;
+        delta *= 10;
+        char d = (char)(p2 >> -one.e);
+        if (d != 0 || len != 0) buf[len++] = (char)('0' + d);
+        p2 &= one.f - 1;
+        kappa--;
+
+        if (p2 < delta) {
+            *k += kappa;
+            roundGrisu(buf, len, delta, p2, one.f, distance * (-kappa < 20 ? powers[-kappa] : 0));
+            return len;
+        }
+    }
+}
+
+// Shortest digits of a positive finite @value, it is digits * 10^k.
+static usize grisu2(f64 value, char* buf, int* k)
+{
+    const u64 hidden = 1ULL << 52;
+    u64 bits;
+    memcpy(&bits, &value, sizeof bits);
+
+    int biased = (int)((bits >> 52) & 0x7ff);
+    DiyFp v = { bits & (hidden - 1), biased != 0 ? biased - 1075 : -1074 };
+    if (biased != 0) v.f += hidden;
+
+    // The boundaries halfway to the neighbour doubles.
+    DiyFp plus = { (v.f << 1) + 1, v.e - 1 };
+    while (!(plus.f & (hidden << 1))) {
+        plus.f <<= 1;
+        plus.e--;
+    }
+    plus.f <<= 64 - 52 - 2;
+    plus.e -= 64 - 52 - 2;
+
+    DiyFp minus = v.f == hidden ? (DiyFp){ (v.f << 2) - 1, v.e - 2 } : (DiyFp){ (v.f << 1) - 1, v.e - 1 };
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+
+    DiyFp c = cachedPowerOfTen(plus.e, k);
+    DiyFp w = multiplyDiyFp(normalizeDiyFp(v), c);
+    DiyFp upper = multiplyDiyFp(plus, c);
+    DiyFp lower = multiplyDiyFp(minus, c);
+    upper.f--;
+    lower.f++;
+
+    return generateDigits(w, upper, upper.f - lower.f, buf, k);
+}
+
+usize formatF64(f64 value, char* buf)
+{
+    char* p = buf;
+    if (isnan(value)) {
+        memcpy(buf, "nan", 3);
+        return 3;
+    }
+    if (signbit(value)) {
+        *p++ = '-';
+        value = -value;
+    }
+    if (isinf(value)) {
+        memcpy(p, "inf", 3);
+        return (usize)(p - buf) + 3;
+    }
+    if (value == 0) {
+        *p++ = '0';
+        return (usize)(p - buf);
+    }
+
+    char digits[24];
+    int k;
+    usize len = grisu2(value, digits, &k);
+
+    // The value is 0.digits * 10^point.
+    int point = (int)len + k;
+
+    if (k >= 0 && point <= 21) {
+        // 1234e7 -> 12340000000
+        memcpy(p, digits, len);
+        memset(p + len, '0', (usize)k);
+        p += point;
+    } else if (point > 0 && point <= 21) {
+        // 1234e-2 -> 12.34
+        memcpy(p, digits, (usize)point);
+        p[point] = '.';
+        memcpy(p + point + 1, digits + point, len - (usize)point);
+        p += len + 1;
+    } else if (point > -6 && point <= 0) {
+        // 1234e-6 -> 0.001234
+        usize zeros = (usize)-point;
+        p[0] = '0';
+        p[1] = '.';
+        memset(p + 2, '0', zeros);
+        memcpy(p + 2 + zeros, digits, len);
+        p += 2 + zeros + len;
+    } else {
+        // 1234e30 -> 1.234e33
+        *p++ = digits[0];
+        if (len > 1) {
+            *p++ = '.';
+            memcpy(p, digits + 1, len - 1);
+            p += len - 1;
+        }
+        *p++ = 'e';
+        p += formatI64(point - 1, p);
+    }
+
+    return (usize)(p - buf);
+}
+
+void appendU64ToString(String* string, u64 value)
+{
+    char buf[MISC_NUMBER_CHARS];
+    appendBytesToString(string, buf, formatU64(value, buf));
+}
+
+void appendI64ToString(String* string, i64 value)
+{
+    char buf[MISC_NUMBER_CHARS];
+    appendBytesToString(string, buf, formatI64(value, buf));
+}
+
+void appendF64ToString(String* string, f64 value)
+{
+    char buf[MISC_NUMBER_CHARS];
+    appendBytesToString(string, buf, formatF64(value, buf));
+}
+#endif
+
+/*
+
+Substring search.
+
+findSv() filters the candidates 16 or 32 at a time with SSE2 or AVX2 by
+comparing the first and the last byte of @needle, and only then compares
+the rest. When too many candidates fail late, like looking for "aaab"
+in "aaaa...", it switches to Two-Way for the rest of the view, so the
+search never gets worse than linear. Without SIMD it is Two-Way only.
+
+An empty @needle is found at zero, countSv() counts the matches that
+don't overlap, and replaceAllSv() builds the result in a single pass
+over the view.
+
+API:
+bool findSv(StringView* sv, StringView* needle, usize* index);
+    Set @index (can be null) to the first match, returns false if there is none.
+
+bool containsSv(StringView* sv, StringView* needle);
+usize countSv(StringView* sv, StringView* needle);
+String replaceAllSv(StringView* sv, StringView* from, StringView* to);
+String replaceAllSvWith(Allocator* allocator, StringView* sv, StringView* from, StringView* to);
+
+*/
+bool findSv(StringView* sv, StringView* needle, usize* index);
+bool containsSv(StringView* sv, StringView* needle);
+usize countSv(StringView* sv, StringView* needle);
+String replaceAllSv(StringView* sv, StringView* from, StringView* to);
+String replaceAllSvWith(Allocator* allocator, StringView* sv, StringView* from, StringView* to);
+
+/*
+
+Multi pattern matcher (Aho-Corasick), finds every occurrence of any of
+the patterns in one pass over the view, whatever the number of patterns.
+
+The trie is turned into a full transition table, so the scan is one
+lookup per byte. Bytes that don't appear in any pattern share a single
+column, so the table is (states x distinct pattern bytes) u32, not 256
+columns per state.
+
+Matches come out by their end, and the ones that end at the same byte
+from the longest to the shortest, overlapping ones included. Empty
+patterns never match, and only the first of duplicated patterns does.
+
+API:
+MultiMatcher initMultiMatcher(StringView* patterns, usize count);
+MultiMatcher initMultiMatcherWith(Allocator* allocator, StringView* patterns, usize count);
+    The patterns are copied, they can go away after this.
+
+bool nextMultiMatch(MultiMatcher* matcher, StringView* sv, MultiMatch* match);
+    Start with a zeroed @match, and keep passing the same one to get
+    the next match, returns false when the view is done.
+
+void freeMultiMatcher(MultiMatcher* matcher);
+
+Example:
+    MultiMatch match = {0};
+    while (nextMultiMatch(&matcher, &text, &match))
+        printfn("%zu at %zu", match.pattern, match.begin);
+
+*/
+typedef struct {
+    Array(u32) next;      // states x classes, the state after a byte.
+    Array(u32) output;    // The pattern ending at a state, plus one, or zero.
+    Array(u32) suffix;    // The longest proper suffix state with an output.
+    Array(u32) lengths;   // Length of every pattern.
+    u16 classes[256];     // The column of every byte in @next.
+    usize classCount;
+} MultiMatcher;
+
+typedef struct {
+    usize pattern; // Index into the patterns given to initMultiMatcher().
+    usize begin;   // Where the match starts in the view.
+    usize len;
+
+    // Where the scan is, only for nextMultiMatch().
+    usize at;
+    u32 state;
+    u32 pending;
+} MultiMatch;
+
+MultiMatcher initMultiMatcher(StringView* patterns, usize count);
+MultiMatcher initMultiMatcherWith(Allocator* allocator, StringView* patterns, usize count);
+bool nextMultiMatch(MultiMatcher* matcher, StringView* sv, MultiMatch* match);
+void freeMultiMatcher(MultiMatcher* matcher);
+
+#ifdef MISC_IMPL
+/*
+Two-Way string matching by Crochemore and Perrin, with the bad character
+shift on the last byte of the window, as in musl memmem().
+*/
+static const u8* twoWaySearch(
+    const u8* h,
+    usize     hlen,
+    const u8* n,
+    usize     l)
+{
+    const u8* z = h + hlen;
+    usize ip, jp, k, p, ms, p0, mem, mem0;
+    usize shift[256];
+    u8 seen[32] = {0};
+
+    for (usize i = 0; i < l; i++) {
+        seen[n[i] >> 3] |= (u8)(1 << (n[i] & 7));
+        shift[n[i]] = i + 1;
+    }
+
+    // The maximal suffix for the byte order, then the reversed one.
+    ip = (usize)-1; jp = 0; k = p = 1;
+    while (jp + k < l) {
+        if (n[ip + k] == n[jp + k]) {
+            if (k == p) {
+                jp += p;
+                k = 1;
+            } else k++;
+        } else if (n[ip + k] > n[jp + k]) {
+            jp += k;
+            k = 1;
+            p = jp - ip;
+        } else {
+            ip = jp++;
+            k = p = 1;
+        }
+    }
+    ms = ip;
+    p0 = p;
+
+    ip = (usize)-1; jp = 0; k = p = 1;
+    while (jp + k < l) {
+        if (n[ip + k] == n[jp + k]) {
+            if (k == p) {
+                jp += p;
+                k = 1;
+            } else k++;
+        } else if (n[ip + k] < n[jp + k]) {
+            jp += k;
+            k = 1;
+            p = jp - ip;
+        } else {
+            ip = jp++;
+            k = p = 1;
+        }
+    }
+    if (ip + 1 > ms + 1) ms = ip;
+    else p = p0;
+
+    // A periodic needle remembers how much of its prefix already matched.
+    if (memcmp(n, n + p, ms + 1) != 0) {
+        mem0 = 0;
+        p = (ms > l - ms - 1 ? ms : l - ms - 1) + 1;
+    } else {
+        mem0 = l - p;
+    }
+    mem = 0;
+
+    for (;;) {
+        if ((usize)(z - h) < l) return NULL;
+
+        u8 last = h[l - 1];
+        if (seen[last >> 3] & (1 << (last & 7))) {
+            k = l - shift[last];
+            if (k != 0) {
+                if (k < mem) k = mem;
+                h += k;
+                mem = 0;
+                continue;
+            }
+        } else {
+            h += l;
+            mem = 0;
+            continue;
+        }
+
+        for (k = ms + 1 > mem ? ms + 1 : mem; k < l && n[k] == h[k]; k++);
+        if (k < l) {
+            h += k - ms;
+            mem = 0;
+            continue;
+        }
+
+        for (k = ms + 1; k > mem && n[k - 1] == h[k - 1]; k--);
+        if (k <= mem) return h;
+        h += p;
+        mem = mem0;
+    }
+}
+
+/*
+Candidates are the positions where both the first and the last byte of
+@n match. Past this many compared bytes per scanned byte, the filter is
+losing to Two-Way.
+*/
+#define MISC_SEARCH_BUDGET(scanned) (4 * (scanned) + 4096)
+
+static const u8* searchBytes(
+    const u8* h,
+    usize     hlen,
+    const u8* n,
+    usize     l)
+{
+#if defined(MISC_SSE2)
+    usize i = 0, end = hlen - l + 1, compared = 0;
+
+#if defined(MISC_AVX2)
+    __m256i first32 = _mm256_set1_epi8((char)n[0]);
+    __m256i last32 = _mm256_set1_epi8((char)n[l - 1]);
+    for (; i + 32 <= end; i += 32) {
+        __m256i a = _mm256_cmpeq_epi8(first32, _mm256_loadu_si256((const __m256i*)(h + i)));
+        __m256i b = _mm256_cmpeq_epi8(last32, _mm256_loadu_si256((const __m256i*)(h + i + l - 1)));
+        u32 mask = (u32)_mm256_movemask_epi8(_mm256_and_si256(a, b));
+
+        for (; mask != 0; mask &= mask - 1) {
+            usize at = i + (usize)__builtin_ctz(mask);
+            if (memcmp(h + at + 1, n + 1, l - 2) == 0) return h + at;
+            compared += l;
+        }
+        if (compared > MISC_SEARCH_BUDGET(i))
+            return twoWaySearch(h + i + 32, hlen - i - 32, n, l);
+    }
+#endif
+
+    __m128i first = _mm_set1_epi8((char)n[0]);
+    __m128i last = _mm_set1_epi8((char)n[l - 1]);
+    for (; i + 16 <= end; i += 16) {
+        __m128i a = _mm_cmpeq_epi8(first, _mm_loadu_si128((const __m128i*)(h + i)));
+        __m128i b = _mm_cmpeq_epi8(last, _mm_loadu_si128((const __m128i*)(h + i + l - 1)));
+        u32 mask = (u32)_mm_movemask_epi8(_mm_and_si128(a, b));
+
+        for (; mask != 0; mask &= mask - 1) {
+            usize at = i + (usize)__builtin_ctz(mask);
+            if (memcmp(h + at + 1, n + 1, l - 2) == 0) return h + at;
+            compared += l;
+        }
+        if (compared > MISC_SEARCH_BUDGET(i))
+            return twoWaySearch(h + i + 16, hlen - i - 16, n, l);
+    }
+
+    for (; i < end; i++)
+        if (h[i] == n[0] && memcmp(h + i + 1, n + 1, l - 1) == 0) return h + i;
+    return NULL;
+#else
+    return twoWaySearch(h, hlen, n, l);
+#endif
+}
+
+bool findSv(
+    StringView* sv,
+    StringView* needle,
+    usize*      index)
+{
+    const u8* h = (const u8*)sv->items;
+    const u8* n = (const u8*)needle->items;
+    const u8* found;
+
+    if (needle->len == 0) {
+        found = h;
+    } else if (needle->len > sv->len) {
+        return false;
+    } else if (needle->len == 1) {
+        found = memchr(h, n[0], sv->len);
+    } else {
+        found = searchBytes(h, sv->len, n, needle->len);
+    }
+
+    if (found == NULL) return false;
+    if (index != NULL) *index = (usize)(found - h);
+    return true;
+}
+
+bool containsSv(StringView* sv, StringView* needle)
+{
+    return findSv(sv, needle, NULL);
+}
+
+usize countSv(StringView* sv, StringView* needle)
+{
+    usize count = 0, index;
+    if (needle->len == 0) return 0;
+
+    StringView rest = *sv;
+    while (findSv(&rest, needle, &index)) {
+        count++;
+        rest.items += index + needle->len;
+        rest.len -= index + needle->len;
+    }
+    return count;
+}
+
+String replaceAllSv(
+    StringView* sv,
+    StringView* from,
+    StringView* to)
+{
+    return replaceAllSvWith(NULL, sv, from, to);
+}
+
+String replaceAllSvWith(
+    Allocator*  allocator,
+    StringView* sv,
+    StringView* from,
+    StringView* to)
+{
+    String result = { .allocator = allocator };
+    StringView rest = *sv;
+    usize index;
+
+    // Most replacements barely change the length, start from the input.
+    reserveArray(&result, sv->len + 1);
+    while (from->len > 0 && findSv(&rest, from, &index)) {
+        appendBytesToString(&result, rest.items, index);
+        appendSvToString(&result, to);
+        rest.items += index + from->len;
+        rest.len -= index + from->len;
+    }
+
+    appendSvToString(&result, &rest);
+    return result;
+}
+
+MultiMatcher initMultiMatcher(StringView* patterns, usize count)
+{
+    return initMultiMatcherWith(NULL, patterns, count);
+}
+
+MultiMatcher initMultiMatcherWith(
+    Allocator*  allocator,
+    StringView* patterns,
+    usize       count)
+{
+    MultiMatcher matcher = {0};
+    matcher.next.allocator = allocator;
+    matcher.output.allocator = allocator;
+    matcher.suffix.allocator = allocator;
+    matcher.lengths.allocator = allocator;
+
+    // Column zero is for every byte that isn't in any pattern.
+    usize classes = 1;
+    for (usize i = 0; i < count; i++) {
+        for (usize j = 0; j < patterns[i].len; j++) {
+            u8 c = (u8)patterns[i].items[j];
+            if (matcher.classes[c] == 0) matcher.classes[c] = (u16)classes++;
+        }
+    }
+    matcher.classCount = classes;
+
+    // The trie, a zero edge is a missing child since nothing goes back to the root.
+    resizeArray(&matcher.next, classes);
+    appendArray(&matcher.output, 0);
+    for (usize i = 0; i < count; i++) {
+        u32 state = 0;
+        for (usize j = 0; j < patterns[i].len; j++) {
+            u32* edge = &matcher.next.items[state * classes + matcher.classes[(u8)patterns[i].items[j]]];
+            if (*edge == 0) {
+                *edge = (u32)matcher.output.len;
+                appendArray(&matcher.output, 0);
+
+                usize used = matcher.output.len * classes;
+                if (used > matcher.next.cap)
+                    resizeArray(&matcher.next, growCapacity(matcher.next.cap, used));
+                memset(matcher.next.items + used - classes, 0, classes * sizeof(u32));
+                edge = &matcher.next.items[state * classes + matcher.classes[(u8)patterns[i].items[j]]];
+            }
+            state = *edge;
+        }
+        if (state != 0 && matcher.output.items[state] == 0)
+            matcher.output.items[state] = (u32)i + 1;
+        appendArray(&matcher.lengths, (u32)patterns[i].len);
+    }
+
+    usize states = matcher.output.len;
+    matcher.next.len = states * classes;
+    resizeArray(&matcher.suffix, states);
+    matcher.suffix.len = states;
+
+    /*
+    Breadth first, so the failure state of a child is always complete
+    when it is needed. The missing edges of a state are taken from its
+    failure state, which turns the trie into a full automaton.
+    */
+    Array(u32) queue = { .allocator = allocator };
+    Array(u32) fail = { .allocator = allocator };
+    resizeArray(&queue, states);
+    resizeArray(&fail, states);
+
+    usize head = 0;
+    for (usize c = 0; c < classes; c++) {
+        u32 child = matcher.next.items[c];
+        if (child != 0) {
+            fail.items[child] = 0;
+            matcher.suffix.items[child] = 0;
+            queue.items[queue.len++] = child;
+        }
+    }
+
+    while (head < queue.len) {
+        u32 state = queue.items[head++];
+        u32* row = &matcher.next.items[state * classes];
+        u32* failRow = &matcher.next.items[fail.items[state] * classes];
+
+        for (usize c = 0; c < classes; c++) {
+            u32 child = row[c];
+            if (child == 0 || c == 0) {
+                row[c] = failRow[c];
+                continue;
+            }
+
+            u32 f = failRow[c];
+            fail.items[child] = f;
+            matcher.suffix.items[child] = matcher.output.items[f] != 0 ? f : matcher.suffix.items[f];
+            queue.items[queue.len++] = child;
+        }
+    }
+
+    freeArray(&queue);
+    freeArray(&fail);
+    return matcher;
+}
+
+bool nextMultiMatch(
+    MultiMatcher* matcher,
+    StringView*   sv,
+    MultiMatch*   match)
+{
+    const u32* next = matcher->next.items;
+    const u32* output = matcher->output.items;
+    usize classes = matcher->classCount;
+    u32 state = match->state;
+
+    if (next == NULL) return false;
+
+    // Outputs left at the current position first.
+    u32 pending = match->pending;
+    usize at = match->at;
+
+    for (;;) {
+        if (pending == 0) {
+            if (at >= sv->len) {
+                match->at = at;
+                match->state = state;
+                return false;
+            }
+
+            state = next[state * classes + matcher->classes[(u8)sv->items[at++]]];
+            pending = output[state] != 0 ? state : matcher->suffix.items[state];
+            continue;
+        }
+
+        u32 pattern = output[pending] - 1;
+        match->pattern = pattern;
+        match->len = matcher->lengths.items[pattern];
+        match->begin = at - match->len;
+        match->at = at;
+        match->state = state;
+        match->pending = matcher->suffix.items[pending];
+        return true;
+    }
+}
+
+void freeMultiMatcher(MultiMatcher* matcher)
+{
+    freeArray(&matcher->next);
+    freeArray(&matcher->output);
+    freeArray(&matcher->suffix);
+    freeArray(&matcher->lengths);
+    matcher->classCount = 0;
+}
+#endif
+
+/*
+
+UTF-8, validation and codepoints of a StringView.
+
+isValidUtf8Sv() follows "Validating UTF-8 In Less Than One Instruction
+Per Byte" by Keiser and Lemire with SSSE3 or AVX2, three nibble lookups
+per block find every bad sequence at once. Runs of ASCII are skipped
+32 bytes at a time with SSSE3 and 64 with AVX2. Without SSSE3, it
+checks 8 bytes at a time for ASCII and decodes the rest.
+
+nextCodepointFromSv() cuts one codepoint off the front of @sv, like
+splitSvBy() does with tokens. A byte that doesn't start a valid
+sequence comes out as U+FFFD and only that byte is cut, so the loop
+always moves forward.
+
+The count and offset helpers count the bytes that are not continuation
+bytes, on valid UTF-8 that is the codepoints.
+
+API:
+bool isValidUtf8Sv(StringView* sv);
+bool nextCodepointFromSv(StringView* sv, u32* codepoint);
+usize countCodepointsSv(StringView* sv);
+usize offsetOfCodepointSv(StringView* sv, usize index);
+    The byte offset of the codepoint @index, or the length of @sv when
+    there aren't that many.
+
+Example:
+    u32 codepoint;
+    StringView rest = text;
+    while (nextCodepointFromSv(&rest, &codepoint))
+        printfn("U+%04X", codepoint);
+
+*/
+#define MISC_REPLACEMENT_CHAR (0xfffd)
+
+bool isValidUtf8Sv(StringView* sv);
+bool nextCodepointFromSv(StringView* sv, u32* codepoint);
+usize countCodepointsSv(StringView* sv);
+usize offsetOfCodepointSv(StringView* sv, usize index);
+
+#ifdef MISC_IMPL
+#define isContinuation(c) (((u8)(c) & 0xc0) == 0x80)
+
+// The length of the sequence at @p, or zero if it is not valid.
+static usize decodeUtf8(const u8* p, usize len, u32* codepoint)
+{
+    u8 c = p[0];
+    if (c < 0x80) {
+        *codepoint = c;
+        return 1;
+    }
+
+    usize need;
+    u32 value;
+    u8 low = 0x80, high = 0xbf;
+
+    if (c < 0xc2) return 0;
+    else if (c < 0xe0) need = 2, value = c & 0x1f;
+    else if (c < 0xf0) need = 3, value = c & 0x0f;
+    else if (c < 0xf5) need = 4, value = c & 0x07;
+    else return 0;
+
+    // Overlong forms, surrogates and past U+10FFFF show up in the second byte.
+    if (c == 0xe0) low = 0xa0;
+    if (c == 0xed) high = 0x9f;
+    if (c == 0xf0) low = 0x90;
+    if (c == 0xf4) high = 0x8f;
+
+    if (len < need || p[1] < low || p[1] > high) return 0;
+    value = value << 6 | (p[1] & 0x3f);
+
+    for (usize i = 2; i < need; i++) {
+        if (!isContinuation(p[i])) return 0;
+        value = value << 6 | (p[i] & 0x3f);
+    }
+
+    *codepoint = value;
+    return need;
+}
+
+static bool validateUtf8Scalar(const u8* p, usize len)
+{
+    usize i = 0;
+    u32 codepoint;
+
+    while (i < len) {
+        if (i + 8 <= len) {
+            u64 word;
+            memcpy(&word, p + i, sizeof word);
+            if ((word & 0x8080808080808080ULL) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+
+        usize n = decodeUtf8(p + i, len - i, &codepoint);
+        if (n == 0) return false;
+        i += n;
+    }
+    return true;
+}
+
+#if defined(MISC_SSSE3)
+// Error bits, each table entry holds the errors the nibble is part of.
+#define UTF8_TOO_SHORT   (1 << 0)
+#define UTF8_TOO_LONG    (1 << 1)
+#define UTF8_OVERLONG_3  (1 << 2)
+#define UTF8_TOO_LARGE   (1 << 3)
+#define UTF8_SURROGATE   (1 << 4)
+#define UTF8_OVERLONG_2  (1 << 5)
+#define UTF8_TOO_LARGE_2 (1 << 6)
+#define UTF8_OVERLONG_4  (1 << 6)
+#define UTF8_TWO_CONTS   ((char)0x80)
+#define UTF8_CARRY       (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+#define UTF8_FIRST_HIGH                                                        \
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,                \
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,                \
+    UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,            \
+    UTF8_TOO_SHORT | UTF8_OVERLONG_2,                                          \
+    UTF8_TOO_SHORT,                                                            \
+    UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,                         \
+    UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_2 | UTF8_OVERLONG_4
+
+#define UTF8_FIRST_LOW                                                         \
+    UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,          \
+    UTF8_CARRY | UTF8_OVERLONG_2,                                              \
+    UTF8_CARRY,                                                                \
+    UTF8_CARRY,                                                                \
+    UTF8_CARRY | UTF8_TOO_LARGE,                                               \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_2,                            \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_2,                            \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_2,                            \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_2,                            \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_2,                            \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_2,                            \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_2,                            \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_2,                            \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_2 | UTF8_SURROGATE,           \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_2,                            \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_2
+
+#define UTF8_SECOND_HIGH                                                                                        \
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,                                             \
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,                                             \
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_2 | UTF8_OVERLONG_4,     \
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,                        \
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,                         \
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,                         \
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+#endif
+
+#if defined(MISC_AVX2)
+#define UTF8_BLOCK (32)
+
+#define utf8Table(...) _mm256_setr_epi8(__VA_ARGS__, __VA_ARGS__)
+
+// @input shifted by @n bytes, with the last bytes of @prev shifted in.
+#define utf8Prev(input, prev, n) \
+    _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - (n))
+
+static __m256i checkUtf8Block(__m256i input, __m256i prev)
+{
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    __m256i prev1 = utf8Prev(input, prev, 1);
+
+    __m256i firstHigh = _mm256_shuffle_epi8(utf8Table(UTF8_FIRST_HIGH),
+                                            _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble));
+    __m256i firstLow = _mm256_shuffle_epi8(utf8Table(UTF8_FIRST_LOW), _mm256_and_si256(prev1, nibble));
+    __m256i secondHigh = _mm256_shuffle_epi8(utf8Table(UTF8_SECOND_HIGH),
+                                             _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble));
+    __m256i special = _mm256_and_si256(_mm256_and_si256(firstHigh, firstLow), secondHigh);
+
+    // The third and fourth byte of a sequence must be continuations, and nothing else.
+    __m256i third = _mm256_subs_epu8(utf8Prev(input, prev, 2), _mm256_set1_epi8((char)(0xe0 - 0x80)));
+    __m256i fourth = _mm256_subs_epu8(utf8Prev(input, prev, 3), _mm256_set1_epi8((char)(0xf0 - 0x80)));
+    __m256i must = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8((char)0x80));
+    return _mm256_xor_si256(must, special);
+}
+
+// Non zero if the block ends in the middle of a sequence.
+static __m256i incompleteUtf8Block(__m256i input)
+{
+    const __m256i max = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        (char)(0xf0 - 1), (char)(0xe0 - 1), (char)(0xc0 - 1));
+    return _mm256_subs_epu8(input, max);
+}
+
+static bool validateUtf8(const u8* p, usize len)
+{
+    __m256i error = _mm256_setzero_si256();
+    __m256i prev = _mm256_setzero_si256();
+    __m256i incomplete = _mm256_setzero_si256();
+    u8 tail[UTF8_BLOCK] = {0};
+    usize i = 0;
+
+    // Two blocks of ASCII are skipped together.
+    for (; i + 2 * UTF8_BLOCK <= len; i += 2 * UTF8_BLOCK) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(p + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(p + i + UTF8_BLOCK));
+
+        if (_mm256_movemask_epi8(_mm256_or_si256(a, b)) == 0) {
+            error = _mm256_or_si256(error, incomplete);
+            incomplete = _mm256_setzero_si256();
+        } else {
+            error = _mm256_or_si256(error, checkUtf8Block(a, prev));
+            error = _mm256_or_si256(error, checkUtf8Block(b, a));
+            incomplete = incompleteUtf8Block(b);
+        }
+        prev = b;
+    }
+
+    for (;;) {
+        __m256i input;
+        bool last = len - i < UTF8_BLOCK;
+        if (last) {
+            memcpy(tail, p + i, len - i);
+            input = _mm256_loadu_si256((const __m256i*)tail);
+        } else {
+            input = _mm256_loadu_si256((const __m256i*)(p + i));
+        }
+
+        if (_mm256_movemask_epi8(input) == 0) {
+            error = _mm256_or_si256(error, incomplete);
+        } else {
+            error = _mm256_or_si256(error, checkUtf8Block(input, prev));
+            incomplete = incompleteUtf8Block(input);
+        }
+
+        prev = input;
+        if (last) break;
+        i += UTF8_BLOCK;
+    }
+
+    return _mm256_testz_si256(error, error);
+}
+#elif defined(MISC_SSSE3)
+#define UTF8_BLOCK (16)
+
+#define utf8Table(...) _mm_setr_epi8(__VA_ARGS__)
+#define utf8Prev(input, prev, n) _mm_alignr_epi8(input, prev, 16 - (n))
+
+static __m128i checkUtf8Block(__m128i input, __m128i prev)
+{
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    __m128i prev1 = utf8Prev(input, prev, 1);
+
+    __m128i firstHigh = _mm_shuffle_epi8(utf8Table(UTF8_FIRST_HIGH),
+                                         _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble));
+    __m128i firstLow = _mm_shuffle_epi8(utf8Table(UTF8_FIRST_LOW), _mm_and_si128(prev1, nibble));
+    __m128i secondHigh = _mm_shuffle_epi8(utf8Table(UTF8_SECOND_HIGH),
+                                          _mm_and_si128(_mm_srli_epi16(input, 4), nibble));
+    __m128i special = _mm_and_si128(_mm_and_si128(firstHigh, firstLow), secondHigh);
+
+    // The third and fourth byte of a sequence must be continuations, and nothing else.
+    __m128i third = _mm_subs_epu8(utf8Prev(input, prev, 2), _mm_set1_epi8((char)(0xe0 - 0x80)));
+    __m128i fourth = _mm_subs_epu8(utf8Prev(input, prev, 3), _mm_set1_epi8((char)(0xf0 - 0x80)));
+    __m128i must = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8((char)0x80));
+    return _mm_xor_si128(must, special);
+}
+
+// Non zero if the block ends in the middle of a sequence.
+static __m128i incompleteUtf8Block(__m128i input)
+{
+    const __m128i max = _mm_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        (char)(0xf0 - 1), (char)(0xe0 - 1), (char)(0xc0 - 1));
+    return _mm_subs_epu8(input, max);
 }
 
-char* cstrArenaPrintf(
-    Arena*      arena,
-    const char* fmt,
-                ...)
+static bool validateUtf8(const u8* p, usize len)
 {
-    va_list va;
-    char* buf = NULL;
-    int size = 0;
+    __m128i error = _mm_setzero_si128();
+    __m128i prev = _mm_setzero_si128();
+    __m128i incomplete = _mm_setzero_si128();
+    u8 tail[UTF8_BLOCK] = {0};
+    usize i = 0;
 
-    va_start(va, fmt);
-    size = vsnprintf(NULL, 0, fmt, va);
-    va_end(va);
+    // Two blocks of ASCII are skipped together.
+    for (; i + 2 * UTF8_BLOCK <= len; i += 2 * UTF8_BLOCK) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(p + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(p + i + UTF8_BLOCK));
+
+        if (_mm_movemask_epi8(_mm_or_si128(a, b)) == 0) {
+            error = _mm_or_si128(error, incomplete);
+            incomplete = _mm_setzero_si128();
+        } else {
+            error = _mm_or_si128(error, checkUtf8Block(a, prev));
+            error = _mm_or_si128(error, checkUtf8Block(b, a));
+            incomplete = incompleteUtf8Block(b);
+        }
+        prev = b;
+    }
 
-    if (size > 0) {
-        buf = allocArena(arena, (usize)size + 1);
-        va_start(va, fmt);
-        vsnprintf(buf, (usize)size + 1, fmt, va);
-        va_end(va);
+    for (;;) {
+        __m128i input;
+        bool last = len - i < UTF8_BLOCK;
+        if (last) {
+            memcpy(tail, p + i, len - i);
+            input = _mm_loadu_si128((const __m128i*)tail);
+        } else {
+            input = _mm_loadu_si128((const __m128i*)(p + i));
+        }
+
+        if (_mm_movemask_epi8(input) == 0) {
+            error = _mm_or_si128(error, incomplete);
+        } else {
+            error = _mm_or_si128(error, checkUtf8Block(input, prev));
+            incomplete = incompleteUtf8Block(input);
+        }
+
+        prev = input;
+        if (last) break;
+        i += UTF8_BLOCK;
     }
 
-    return buf;
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xffff;
 }
+#else
+#define validateUtf8 validateUtf8Scalar
+#endif
 
-char* cstrPrintf(const char* fmt, ...)
+bool isValidUtf8Sv(StringView* sv)
 {
-    va_list va;
-    char* buf = NULL;
-    int size = 0;
+#ifdef UTF8_BLOCK
+    // Shorter than a block is faster without the tail copy.
+    if (sv->len < UTF8_BLOCK)
+        return validateUtf8Scalar((const u8*)sv->items, sv->len);
+#endif
+    return validateUtf8((const u8*)sv->items, sv->len);
+}
 
-    va_start(va, fmt);
-    size = vsnprintf(NULL, 0, fmt, va);
-    va_end(va);
+bool nextCodepointFromSv(StringView* sv, u32* codepoint)
+{
+    if (sv->len == 0) return false;
 
-    if (size > 0) {
-        buf = strictAlloc((usize)size + 1);
-        va_start(va, fmt);
-        vsnprintf(buf, (usize)size + 1, fmt, va);
-        va_end(va);
+    usize n = decodeUtf8((const u8*)sv->items, sv->len, codepoint);
+    if (n == 0) {
+        *codepoint = MISC_REPLACEMENT_CHAR;
+        n = 1;
     }
 
-    return buf;
+    sv->items += n;
+    sv->len -= n;
+    return true;
 }
 
-String stringPrintf(const char* fmt, ...)
+// Bytes in @p that start a codepoint, @p must hold 16 bytes.
+#if defined(MISC_SSE2)
+static inline usize countLeadBytes16(const u8* p)
 {
-    String str = {0};
-    va_list va;
-    va_start(va, fmt);
-    int size = vsnprintf(NULL, 0, fmt, va);
-    va_end(va);
+    // Continuations are 0x80..0xbf, below -64 as signed bytes.
+    __m128i leads = _mm_cmpgt_epi8(_mm_loadu_si128((const __m128i*)p), _mm_set1_epi8(-65));
+    return (usize)__builtin_popcount((u32)_mm_movemask_epi8(leads));
+}
+#endif
 
-    if (size > 0) {
-        resizeArray(&str, (usize)size + 1);
-        va_start(va, fmt);
-        vsnprintf(str.items, str.cap, fmt, va);
-        va_end(va);
-        str.len += size;
-    }
+usize countCodepointsSv(StringView* sv)
+{
+    const u8* p = (const u8*)sv->items;
+    usize count = 0, i = 0;
 
-    return str;
+#if defined(MISC_SSE2)
+    for (; i + 16 <= sv->len; i += 16)
+        count += countLeadBytes16(p + i);
+#endif
+    for (; i < sv->len; i++)
+        count += !isContinuation(p[i]);
+    return count;
+}
+
+usize offsetOfCodepointSv(StringView* sv, usize index)
+{
+    const u8* p = (const u8*)sv->items;
+    usize seen = 0, i = 0;
+
+#if defined(MISC_SSE2)
+    // Whole blocks that end before the codepoint are only counted.
+    for (; i + 16 <= sv->len; i += 16) {
+        usize leads = countLeadBytes16(p + i);
+        if (seen + leads > index) break;
+        seen += leads;
+    }
+#endif
+    for (; i < sv->len; i++) {
+        if (isContinuation(p[i])) continue;
+        if (seen == index) return i;
+        seen++;
+    }
+    return sv->len;
 }
 #endif
 
@@ -710,6 +4179,26 @@ String stringPrintf(const char* fmt, ...)
 #define MISC_MAP_MINIMUM (8)
 #endif
 
+#ifndef MISC_MAP_INLINE_KEY
+#define MISC_MAP_INLINE_KEY (16)
+#endif
+
+#ifndef MISC_MAP_ARENA_SIZE
+#define MISC_MAP_ARENA_SIZE (64 << 10)
+#endif
+
+// Slab slot sizes are 16, 32, ... up to 16 << (MISC_MAP_SLAB_CLASSES - 1).
+#ifndef MISC_MAP_SLAB_CLASSES
+#define MISC_MAP_SLAB_CLASSES (6)
+#endif
+
+#define MISC_MAP_STORE_HEAP  0
+#define MISC_MAP_STORE_ARENA 1
+#define MISC_MAP_STORE_SLABS 2
+
+#define MISC_MAP_SWISS      (1 << 0)
+#define MISC_MAP_ROBIN_HOOD (1 << 1)
+
 /*
 
 A proper Hash map with open addressing, inspired from the book
@@ -734,13 +4223,60 @@ until N capacity of table. deleteFromMap() will only free
 1 entry of K and V, marking it as tombstone and can be used again
 if needed.
 
+By default every K and V pair is a separate malloc(). @storage picks
+where the map keeps them instead, set it before the first putInMap():
+- MISC_MAP_STORE_ARENA, pairs are bumped out of an arena owned by the
+  map. deleteFromMap() doesn't give the memory back, freeMap() drops
+  the whole arena at once.
+- MISC_MAP_STORE_SLABS, pairs are slots of pools owned by the map, one
+  per power of two size from 16 bytes up, deleteFromMap() releases the
+  slot for reuse. Bigger pairs are still a malloc().
+If @pool is set before the first putInMap(), the pairs are slots of
+that pool instead, every key length + value size (rounded to
+MISC_ALIGN) must fit in its slot size. The pool is not freed by
+freeMap().
+
+Keys up to MISC_MAP_INLINE_KEY bytes are stored in the entry itself,
+so probing compares them without following a pointer, and their pair
+only holds the value. @key of such an entry points into the table, it
+moves when the map grows.
+
+If @allocator is set before the first putInMap(), both the table and
+the pairs (unless @pool is set) come from it. With an arena allocator,
+the whole map is dropped by resetArena() without calling freeMap().
+
+Keys are hashed with initWyhash(), which reads 8 or 16 bytes per step.
+Set @hash to use another function, and @seed to a random value to keep
+keys from an attacker from all landing in the same buckets. Both must be
+set before the first putInMap(). initFNV() is kept for the callers that
+need its exact values.
+
+With MISC_MAP_SWISS in @flags, the map keeps one control byte per
+slot next to the table, either empty, deleted or 7 bits of the hash.
+Probing compares 16 control bytes at a time and only reads the entries
+whose byte matches, so a miss usually costs one cache line. @maxLoad
+is the most of the table that is ever used, MISC_MAP_LOADF when 0. Both
+must be set before initMap() or the first putInMap().
+
+The slots left by deleteFromMap() are counted in @tombstones and in the
+load factor. When one more key would take live keys and tombstones past
+@maxLoad, the table is rehashed in place if no more than half of that
+is live keys, and grown
+otherwise, so probes stay short under insert and delete churn.
+With MISC_MAP_ROBIN_HOOD in @flags instead, a key that probed further
+from its home slot takes the slot of one that is closer to home, and
+deleteFromMap() shifts the following keys back instead of leaving a
+tombstone. It can't be combined with MISC_MAP_SWISS.
+
 */
 
 typedef struct {
     void* key;
     void* value;
     u64 hash;
-    usize keyLen;
+    u32 keyLen;
+    u32 pairSize;
+    u8 inlineKey[MISC_MAP_INLINE_KEY];
 } MapEntry;
 
 typedef struct {
@@ -754,9 +4290,21 @@ typedef struct {
     MapEntry* items;
     usize cap;
     usize len;
+    Allocator* allocator;
+    Pool* pool;
+    u64 (*hash)(const void* key, usize keyLen, u64 seed);
+    u64 seed;
+    int storage;
+    Arena* arena;
+    Pool* slabs;
+    int flags;
+    f64 maxLoad;
+    u8* ctrl;
+    usize tombstones;
 } Map;
 
 u64 initFNV(const void* ptr, usize size);
+u64 initWyhash(const void* ptr, usize size, u64 seed);
 void initMap(Map* map);
 void putInMap(Map* map, const void* key, usize keyLen, const void* value, usize valueSize);
 void* getFromMap(Map* map, const void* key, usize keyLen);
@@ -765,33 +4313,154 @@ bool iterateMap(Map* map, MapKV* input);
 void freeMap(Map* map);
 
 #ifdef MISC_IMPL
-#define mapLoadFactor(map) ((f64)(map)->len / (f64)(map)->cap)
+#define mapMaxLoad(map) ((map)->maxLoad > 0 ? (map)->maxLoad : MISC_MAP_LOADF)
+
+// One more key would take the table past its load, checked before every insert
+// so at least one slot stays empty and every probe ends.
+#define isMapOverloaded(map) ((f64)((map)->len + (map)->tombstones + 1) > (f64)(map)->cap * mapMaxLoad(map))
+
+/*
+Control bytes of MISC_MAP_SWISS, a full slot holds the low 7 bits of
+its hash. The first MAP_GROUP bytes are mirrored after the last slot,
+so a group can be loaded from any slot without wrapping.
+*/
+#define MAP_GROUP        16
+#define MAP_CTRL_EMPTY   ((u8)0x80)
+#define MAP_CTRL_DELETED ((u8)0xfe)
+#define mapCtrlTag(hash) ((u8)((hash) & 0x7f))
+
+static void setMapCtrl(Map* map, usize index, u8 ctrl)
+{
+    map->ctrl[index] = ctrl;
+    if (index < MAP_GROUP) map->ctrl[map->cap + index] = ctrl;
+}
 
 void initMap(Map* map)
 {
-    resizeArray(map, MISC_MAP_MINIMUM);
+    miscAssert(map->maxLoad < 1.0, "load factor must be less than 1.0");
+    miscAssert((map->flags & (MISC_MAP_SWISS | MISC_MAP_ROBIN_HOOD)) != (MISC_MAP_SWISS | MISC_MAP_ROBIN_HOOD),
+               "robin hood map can't use the swiss layout");
+    if (map->flags & MISC_MAP_SWISS) {
+        resizeArray(map, MISC_MAP_MINIMUM < MAP_GROUP ? MAP_GROUP : MISC_MAP_MINIMUM);
+        map->ctrl = allocWith(map->allocator, map->cap + MAP_GROUP);
+        miscAssert(map->ctrl != NULL, "map allocator returns null");
+        memset(map->ctrl, MAP_CTRL_EMPTY, map->cap + MAP_GROUP);
+    } else {
+        resizeArray(map, MISC_MAP_MINIMUM);
+    }
 }
 
+#define isMapKeyInline(keyLen) ((keyLen) <= MISC_MAP_INLINE_KEY)
+
 static bool compareKey(
     MapEntry*   dst,
     const void* key,
     usize       keyLen,
     u64         hash)
 {
+    const void* stored = isMapKeyInline(keyLen) ? dst->inlineKey : dst->key;
     return dst->keyLen == keyLen &&
            dst->hash   == hash   &&
-           memcmp(dst->key, key, keyLen) == 0;
+           memcmp(stored, key, keyLen) == 0;
+}
+
+// Copy an entry into another slot, an inline key must follow it.
+static void moveMapEntry(MapEntry* dest, MapEntry* src)
+{
+    *dest = *src;
+    if (dest->key != NULL && isMapKeyInline(dest->keyLen))
+        dest->key = dest->inlineKey;
+}
+
+static u64 hashMapKey(
+    Map*        map,
+    const void* key,
+    usize       keyLen)
+{
+    if (map->hash != NULL) return map->hash(key, keyLen, map->seed);
+    return initWyhash(key, keyLen, map->seed);
+}
+
+// Bit i is set when control byte i of the group at @ctrl equals @tag.
+#if defined(MISC_SSE2)
+typedef __m128i MapGroup;
+#define loadMapGroup(ctrl) _mm_loadu_si128((const __m128i*)(ctrl))
+
+static inline u32 matchMapGroup(MapGroup group, u8 tag)
+{
+    return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)tag)));
+}
+#else
+typedef const u8* MapGroup;
+#define loadMapGroup(ctrl) (ctrl)
+
+static inline u32 matchMapGroup(MapGroup group, u8 tag)
+{
+    u32 mask = 0;
+    for (usize i = 0; i < MAP_GROUP; i++)
+        mask |= (u32)(group[i] == tag) << i;
+    return mask;
+}
+#endif
+
+/*
+Groups are probed by triangular steps of MAP_GROUP slots, which visit
+every group once when the capacity is a power of two. A new key takes
+the first deleted slot on the way, the lookup stops at the first group
+with an empty slot.
+*/
+static MapEntry* findMapEntrySwiss(
+    Map*        map,
+    const void* key,
+    usize       keyLen,
+    u64         hash)
+{
+    usize mask = map->cap - 1;
+    usize pos = (usize)(hash >> 7) & mask;
+    u8 tag = mapCtrlTag(hash);
+    MapEntry* tombstone = NULL;
+
+    for (usize step = MAP_GROUP;; pos = (pos + step) & mask, step += MAP_GROUP) {
+        MapGroup group = loadMapGroup(map->ctrl + pos);
+
+        for (u32 match = matchMapGroup(group, tag); match != 0; match &= match - 1) {
+            MapEntry* entry = &map->items[(pos + (usize)__builtin_ctz(match)) & mask];
+            if (compareKey(entry, key, keyLen, hash)) return entry;
+        }
+
+        if (tombstone == NULL) {
+            u32 deleted = matchMapGroup(group, MAP_CTRL_DELETED);
+            if (deleted != 0) tombstone = &map->items[(pos + (usize)__builtin_ctz(deleted)) & mask];
+        }
+
+        u32 empty = matchMapGroup(group, MAP_CTRL_EMPTY);
+        if (empty != 0)
+            return tombstone != NULL ? tombstone : &map->items[(pos + (usize)__builtin_ctz(empty)) & mask];
+    }
 }
 
+#define mapProbeDistance(map, entry, idx) (((idx) - (usize)(entry)->hash) & ((map)->cap - 1))
+
 static MapEntry* findMapEntry(
     Map*        map,
     const void* key,
     usize       keyLen,
     u64         hash)
 {
+    if (map->ctrl != NULL) return findMapEntrySwiss(map, key, keyLen, hash);
+
     usize idx = hash & (map->cap - 1);
     MapEntry* tombstone = NULL;
 
+    // Stops at the first key closer to its home, where @key would go.
+    if (map->flags & MISC_MAP_ROBIN_HOOD) {
+        for (usize dist = 0;; idx = (idx + 1) & (map->cap - 1), dist++) {
+            MapEntry* entry = &map->items[idx];
+            if (entry->key == NULL || mapProbeDistance(map, entry, idx) < dist) return entry;
+            if (compareKey(entry, key, keyLen, hash)) return entry;
+        }
+    }
+
     while (true) {
         MapEntry* entry = &map->items[idx];
         if (entry->key == NULL) {
@@ -807,11 +4476,173 @@ static MapEntry* findMapEntry(
     }
 }
 
+// The slab class of @size, or MISC_MAP_SLAB_CLASSES if it's too big.
+static usize mapSlabClass(usize size)
+{
+    usize index = 0;
+    while (index < MISC_MAP_SLAB_CLASSES && ((usize)16 << index) < size)
+        index++;
+    return index;
+}
+
+static void* allocMapPair(Map* map, usize size)
+{
+    void* pair = NULL;
+
+    if (map->pool != NULL) {
+        miscAssert(size <= map->pool->slotSize, "key and value doesn't fit in the map pool");
+        return allocPool(map->pool);
+    }
+
+    if (map->storage == MISC_MAP_STORE_ARENA) {
+        if (map->arena == NULL) map->arena = initArena(MISC_MAP_ARENA_SIZE);
+        pair = allocArena(map->arena, size);
+    } else if (map->storage == MISC_MAP_STORE_SLABS && mapSlabClass(size) < MISC_MAP_SLAB_CLASSES) {
+        if (map->slabs == NULL) {
+            map->slabs = strictAlloc(MISC_MAP_SLAB_CLASSES * sizeof *map->slabs);
+            for (usize i = 0; i < MISC_MAP_SLAB_CLASSES; i++)
+                map->slabs[i] = initPool((usize)16 << i, MISC_MAP_ARENA_SIZE / ((usize)16 << i));
+        }
+        pair = allocPool(&map->slabs[mapSlabClass(size)]);
+    } else {
+        pair = allocWith(map->allocator, size);
+    }
+
+    miscAssert(pair != NULL, "map allocator returns null");
+    return pair;
+}
+
+static void freeMapPair(Map* map, MapEntry* entry)
+{
+    void* pair = isMapKeyInline(entry->keyLen) ? entry->value : entry->key;
+
+    if (map->pool != NULL) {
+        releaseToPool(map->pool, pair);
+    } else if (map->storage == MISC_MAP_STORE_ARENA) {
+        // Only dropped with the whole arena.
+    } else if (map->storage == MISC_MAP_STORE_SLABS && mapSlabClass(entry->pairSize) < MISC_MAP_SLAB_CLASSES) {
+        releaseToPool(&map->slabs[mapSlabClass(entry->pairSize)], pair);
+    } else {
+        freeWith(map->allocator, pair);
+    }
+}
+
+// Robin hood insert, move the keys from @entry up to the next empty slot one forward.
+static void shiftMapEntries(Map* map, MapEntry* entry)
+{
+    usize mask = map->cap - 1;
+    usize at = (usize)(entry - map->items), last = at;
+    while (map->items[last].key != NULL)
+        last = (last + 1) & mask;
+
+    for (; last != at; last = (last - 1) & mask)
+        moveMapEntry(&map->items[last], &map->items[(last - 1) & mask]);
+    memset(entry, 0, sizeof *entry);
+}
+
+/*
+Drop the tombstones without a new table. Linear probing walks once from
+an empty slot, no probe crosses it, and moves every key to the first
+free slot from its home. The swiss layout marks every key as pending
+and places them one by one, swapping with a pending key when it takes
+its slot, the way abseil does.
+*/
+static void rehashMapSwiss(Map* map)
+{
+    usize mask = map->cap - 1;
+    for (usize i = 0; i < map->cap; i++) {
+        bool isFull = map->ctrl[i] != MAP_CTRL_EMPTY && map->ctrl[i] != MAP_CTRL_DELETED;
+        map->ctrl[i] = isFull ? MAP_CTRL_DELETED : MAP_CTRL_EMPTY;
+        if (!isFull) map->items[i].value = NULL;
+    }
+    memcpy(map->ctrl + map->cap, map->ctrl, MAP_GROUP);
+
+    for (usize i = 0; i < map->cap; i++) {
+        if (map->ctrl[i] != MAP_CTRL_DELETED)
+            continue;
+
+        MapEntry* entry = &map->items[i];
+        u8 tag = mapCtrlTag(entry->hash);
+        usize pos = (usize)(entry->hash >> 7) & mask, target = 0;
+        for (usize step = MAP_GROUP;; pos = (pos + step) & mask, step += MAP_GROUP) {
+            MapGroup group = loadMapGroup(map->ctrl + pos);
+            u32 free = matchMapGroup(group, MAP_CTRL_EMPTY) | matchMapGroup(group, MAP_CTRL_DELETED);
+            if (free != 0) {
+                target = (pos + (usize)__builtin_ctz(free)) & mask;
+                break;
+            }
+        }
+
+        // Already in the first group with room, lookups reach it there.
+        usize home = (usize)(entry->hash >> 7) & mask;
+        if (((target - home) & mask) / MAP_GROUP == ((i - home) & mask) / MAP_GROUP) {
+            setMapCtrl(map, i, tag);
+        } else if (map->ctrl[target] == MAP_CTRL_EMPTY) {
+            moveMapEntry(&map->items[target], entry);
+            memset(entry, 0, sizeof *entry);
+            setMapCtrl(map, target, tag);
+            setMapCtrl(map, i, MAP_CTRL_EMPTY);
+        } else {
+            MapEntry pending;
+            moveMapEntry(&pending, &map->items[target]);
+            moveMapEntry(&map->items[target], entry);
+            moveMapEntry(entry, &pending);
+            setMapCtrl(map, target, tag);
+            i--;
+        }
+    }
+}
+
+static void rehashMap(Map* map)
+{
+    map->tombstones = 0;
+    if (map->ctrl != NULL) {
+        rehashMapSwiss(map);
+        return;
+    }
+
+    usize mask = map->cap - 1, start = 0;
+    while (map->items[start].key != NULL || map->items[start].value != NULL)
+        start++;
+
+    for (usize n = 1; n <= map->cap; n++) {
+        usize i = (start + n) & mask;
+        MapEntry* entry = &map->items[i];
+        if (entry->key == NULL) {
+            entry->value = NULL;
+            continue;
+        }
+
+        usize j = entry->hash & mask;
+        while (j != i && map->items[j].key != NULL)
+            j = (j + 1) & mask;
+        if (j != i) {
+            moveMapEntry(&map->items[j], entry);
+            memset(entry, 0, sizeof *entry);
+        }
+    }
+}
+
 static void growMap(Map* map, usize into)
 {
-    Map newer = {0};
+    Map newer = {
+        .allocator = map->allocator,
+        .pool      = map->pool,
+        .hash      = map->hash,
+        .seed      = map->seed,
+        .storage   = map->storage,
+        .arena     = map->arena,
+        .slabs     = map->slabs,
+        .flags     = map->flags,
+        .maxLoad   = map->maxLoad,
+    };
     resizeArray(&newer, into);
     newer.len = map->len;
+    if (map->ctrl != NULL) {
+        newer.ctrl = allocWith(newer.allocator, into + MAP_GROUP);
+        miscAssert(newer.ctrl != NULL, "map allocator returns null");
+        memset(newer.ctrl, MAP_CTRL_EMPTY, into + MAP_GROUP);
+    }
 
     for (usize i = 0; i < map->cap; i++) {
         MapEntry* entry = &map->items[i];
@@ -819,9 +4650,12 @@ static void growMap(Map* map, usize into)
             continue;
 
         MapEntry* dest = findMapEntry(&newer, entry->key, entry->keyLen, entry->hash);
-        *dest = *entry;
+        if (dest->key != NULL) shiftMapEntries(&newer, dest);
+        moveMapEntry(dest, entry);
+        if (newer.ctrl != NULL) setMapCtrl(&newer, (usize)(dest - newer.items), mapCtrlTag(entry->hash));
     }
 
+    freeWith(map->allocator, map->ctrl);
     freeArray(map);
     *map = newer;
 }
@@ -833,37 +4667,82 @@ void putInMap(
     const void* value,
     usize       valueSize)
 {
-    if (map->cap < MISC_MAP_MINIMUM) {
+    if (map->cap == 0) {
         initMap(map);
-    } else if (mapLoadFactor(map) >= MISC_MAP_LOADF) {
-        growMap(map, map->cap * 2);
+    } else if (isMapOverloaded(map)) {
+        if ((f64)map->len * 2 <= (f64)map->cap * mapMaxLoad(map))
+            rehashMap(map);
+        else
+            growMap(map, map->cap * 2);
     }
 
-    u64 hash = initFNV(key, keyLen);
+    u64 hash = hashMapKey(map, key, keyLen);
     MapEntry* entry = findMapEntry(map, key, keyLen, hash);
+    if ((map->flags & MISC_MAP_ROBIN_HOOD) && entry->key != NULL && !compareKey(entry, key, keyLen, hash))
+        shiftMapEntries(map, entry);
+
     bool isNewKey = entry->key == NULL;
     if (isNewKey) {
-        usize merge = keyLen + valueSize;
-        usize roundUp = alignUp(merge);
-        u8* pool = strictAlloc(roundUp);
-        entry->key = pool;
-        entry->value = pool + keyLen + (roundUp - merge);
-        entry->keyLen = keyLen;
+        if ((uintptr_t)entry->value == 0xdead) map->tombstones--;
+        miscAssert(keyLen <= UINT32_MAX && valueSize <= UINT32_MAX - keyLen - MISC_ALIGN,
+                   "key or value is too big for a map");
+
+        /*
+        The value is put at the end of the pair, so it is aligned
+        whenever its size is a multiple of the alignment. With an
+        inline key the pair is only the value, which starts it, so
+        freeMapPair() finds the pair from the value.
+        */
+        usize stored = isMapKeyInline(keyLen) ? 0 : keyLen;
+        usize merge = stored + valueSize;
+        usize roundUp = merge > 0 ? alignUp(merge) : MISC_ALIGN;
+        u8* pair = allocMapPair(map, roundUp);
+
+        entry->key = isMapKeyInline(keyLen) ? entry->inlineKey : pair;
+        entry->value = isMapKeyInline(keyLen) ? pair : pair + roundUp - valueSize;
+        entry->keyLen = (u32)keyLen;
+        entry->pairSize = (u32)roundUp;
         entry->hash = hash;
         memmove(entry->key, key, keyLen);
         map->len++;
+        if (map->ctrl != NULL) setMapCtrl(map, (usize)(entry - map->items), mapCtrlTag(hash));
     }
     memmove(entry->value, value, valueSize);
 }
 
+/*
+False when less than MAP_GROUP slots around @index are taken, then no
+probe ever went past it and it can be empty again instead of deleted.
+*/
+static bool wasMapSlotFull(Map* map, usize index)
+{
+    u32 before = matchMapGroup(loadMapGroup(map->ctrl + ((index - MAP_GROUP) & (map->cap - 1))), MAP_CTRL_EMPTY);
+    u32 after = matchMapGroup(loadMapGroup(map->ctrl + index), MAP_CTRL_EMPTY);
+    if (before == 0 || after == 0) return true;
+    return (usize)__builtin_ctz(after) + (usize)(__builtin_clz(before) - 16) >= MAP_GROUP;
+}
+
+// The entry of @key, or NULL when it isn't in the map.
+static MapEntry* lookupMapEntry(
+    Map*        map,
+    const void* key,
+    usize       keyLen)
+{
+    if (map->cap == 0) return NULL;
+    u64 hash = hashMapKey(map, key, keyLen);
+    MapEntry* entry = findMapEntry(map, key, keyLen, hash);
+    if (entry->key == NULL) return NULL;
+    if ((map->flags & MISC_MAP_ROBIN_HOOD) && !compareKey(entry, key, keyLen, hash)) return NULL;
+    return entry;
+}
+
 void* getFromMap(
     Map*        map,
     const void* key,
     usize       keyLen)
 {
-    MapEntry* entry = findMapEntry(map, key, keyLen, initFNV(key, keyLen));
-    if (entry->key != NULL) return entry->value;
-    return NULL;
+    MapEntry* entry = lookupMapEntry(map, key, keyLen);
+    return entry != NULL ? entry->value : NULL;
 }
 
 void deleteFromMap(
@@ -871,24 +4750,57 @@ void deleteFromMap(
     const void* key,
     usize       keyLen)
 {
-    MapEntry* entry = findMapEntry(map, key, keyLen, initFNV(key, keyLen));
-    if (entry->key == NULL) return;
+    MapEntry* entry = lookupMapEntry(map, key, keyLen);
+    if (entry == NULL) return;
+
+    freeMapPair(map, entry);
+    map->len--;
+
+    // Backward shift, pull the following keys one closer to home.
+    if (map->flags & MISC_MAP_ROBIN_HOOD) {
+        usize mask = map->cap - 1;
+        usize idx = (usize)(entry - map->items), next = (idx + 1) & mask;
+        while (map->items[next].key != NULL && mapProbeDistance(map, &map->items[next], next) > 0) {
+            moveMapEntry(&map->items[idx], &map->items[next]);
+            idx = next;
+            next = (next + 1) & mask;
+        }
+        memset(&map->items[idx], 0, sizeof map->items[idx]);
+        return;
+    }
 
-    free(entry->key);
     memset(entry, 0, sizeof *entry);
+    if (map->ctrl != NULL && !wasMapSlotFull(map, (usize)(entry - map->items))) {
+        setMapCtrl(map, (usize)(entry - map->items), MAP_CTRL_EMPTY);
+        return;
+    }
+
     entry->value = (void*)0xdead;
-    map->len--;
+    map->tombstones++;
+    if (map->ctrl != NULL) setMapCtrl(map, (usize)(entry - map->items), MAP_CTRL_DELETED);
 }
 
 void freeMap(Map* map)
 {
-    for (usize i = 0; i < map->cap; i++) {
-        MapEntry entry = map->items[i];
-        if (entry.key == NULL || (uintptr_t)entry.value == 0xdead)
+    for (usize i = 0; i < map->cap && map->storage != MISC_MAP_STORE_ARENA; i++) {
+        MapEntry* entry = &map->items[i];
+        if (entry->key == NULL || (uintptr_t)entry->value == 0xdead)
             continue;
 
-        free(entry.key);
+        freeMapPair(map, entry);
+    }
+
+    if (map->slabs != NULL) {
+        for (usize i = 0; i < MISC_MAP_SLAB_CLASSES; i++)
+            freePool(&map->slabs[i]);
+        free(map->slabs);
+        map->slabs = NULL;
     }
+    freeArena(map->arena);
+    map->arena = NULL;
+    freeWith(map->allocator, map->ctrl);
+    map->ctrl = NULL;
+    map->tombstones = 0;
     freeArray(map);
 }
 
@@ -909,10 +4821,9 @@ bool iterateMap(Map* map, MapKV* input)
     return false;
 }
 
-u64 initFNV(const void* ptr, usize size)
+static u64 updateFNV(u64 baseValue, const void* ptr, usize size)
 {
     const u8* bytes = ptr;
-    u64 baseValue = MISC_FNV_BASIS;
     for (u64 i = 0; i < size; i++) {
         baseValue *= MISC_FNV_PRIME;
         baseValue ^= bytes[i];
@@ -920,10 +4831,269 @@ u64 initFNV(const void* ptr, usize size)
     return baseValue;
 }
 
+u64 initFNV(const void* ptr, usize size)
+{
+    return updateFNV(MISC_FNV_BASIS, ptr, size);
+}
+
+/*
+wyhash by Wang Yi (final version 4), a 64x64 to 128-bit multiply mixes
+16 bytes per step, and 48 per step with three lanes for long keys.
+*/
+static const u64 wyhashSecret[4] = {
+    0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL, 0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL,
+};
+
+static inline void multiplyWide(u64* a, u64* b)
+{
+#if defined(__SIZEOF_INT128__)
+    __extension__ unsigned __int128 r = (unsigned __int128)*a * *b;
+    *a = (u64)r;
+    *b = (u64)(r >> 64);
+#else
+    u64 ah = *a >> 32, al = (u32)*a, bh = *b >> 32, bl = (u32)*b;
+    u64 hh = ah * bh, hl = ah * bl, lh = al * bh, ll = al * bl;
+    u64 mid = (ll >> 32) + (u32)hl + (u32)lh;
+    *a = (mid << 32) | (u32)ll;
+    *b = hh + (hl >> 32) + (lh >> 32) + (mid >> 32);
+#endif
+}
+
+static inline u64 mixWide(u64 a, u64 b)
+{
+    multiplyWide(&a, &b);
+    return a ^ b;
+}
+
+// Little endian loads, the way the reference reads on x86 and arm.
+static inline u64 read64(const u8* p)
+{
+    u64 v;
+    memcpy(&v, p, sizeof v);
+    return v;
+}
+
+static inline u64 read32(const u8* p)
+{
+    u32 v;
+    memcpy(&v, p, sizeof v);
+    return v;
+}
+
+u64 initWyhash(const void* ptr, usize size, u64 seed)
+{
+    const u8* p = ptr;
+    const u64* secret = wyhashSecret;
+    u64 a, b;
+
+    seed ^= mixWide(seed ^ secret[0], secret[1]);
+    if (size <= 16) {
+        if (size >= 4) {
+            usize shift = (size >> 3) << 2;
+            a = (read32(p) << 32) | read32(p + shift);
+            b = (read32(p + size - 4) << 32) | read32(p + size - 4 - shift);
+        } else if (size > 0) {
+            a = ((u64)p[0] << 16) | ((u64)p[size >> 1] << 8) | p[size - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        usize i = size;
+        if (i > 48) {
+            u64 see1 = seed, see2 = seed;
+            do {
+                seed = mixWide(read64(p) ^ secret[1], read64(p + 8) ^ seed);
+                see1 = mixWide(read64(p + 16) ^ secret[2], read64(p + 24) ^ see1);
+                see2 = mixWide(read64(p + 32) ^ secret[3], read64(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = mixWide(read64(p) ^ secret[1], read64(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = read64(p + i - 16);
+        b = read64(p + i - 8);
+    }
+
+    a ^= secret[1];
+    b ^= seed;
+    multiplyWide(&a, &b);
+    return mixWide(a ^ secret[0] ^ size, b ^ secret[1]);
+}
+
+u64 hashSvIgnoreCase(StringView* sv)
+{
+    u8 folded[64];
+    u64 hash = MISC_FNV_BASIS;
+    const u8* bytes = (const u8*)sv->items;
+
+    for (usize i = 0; i < sv->len; i += sizeof folded) {
+        usize n = sv->len - i < sizeof folded ? sv->len - i : sizeof folded;
+        convertAsciiCase(folded, bytes + i, n, 'A');
+        hash = updateFNV(hash, folded, n);
+    }
+    return hash;
+}
+
 #endif
 
 /*
 
+Hashmap specialized per key and value type at compile time.
+
+Map copies every key and value behind a void*, compares keys with
+memcmp() and hands the value back as a pointer to cast. For keys and
+values of a fixed type, DEFINE_MAP generates a map that keeps both in
+its own table, compares with @eq and returns a V*, without allocating
+anything per entry.
+
+@hash(key) is called with one K and returns an u64, hashU64() mixes
+an integer so its low bits can index the table. @eq(a, b) is called
+with two K, it can be a function-like macro like:
+#define equalNumber(a, b) ((a) == (b))
+
+DEFINE_MAP(U64Map, u64, u64, hashU64, equalNumber)
+
+Generates U64MapEntry { u64 key; u64 value; bool used; } and the map
+U64Map { U64MapEntry* items; usize cap; usize len; Allocator* allocator; },
+zero-initialize it with {0}. Keys are probed linearly and deleting one
+shifts the following keys back, so there are no tombstones.
+
+API:
+void putIn##name(name* map, K key, V value);
+    Insert @key or overwrite its value, growing past MISC_MAP_LOADF.
+
+V* getFrom##name(name* map, K key);
+    Pointer to the value of @key inside the table, or NULL. It is
+    invalidated by the next putIn##name() or deleteFrom##name().
+
+bool deleteFrom##name(name* map, K key);
+    Remove @key, false if it wasn't there.
+
+name##Entry* iterate##name(name* map, usize* pos);
+    Next used entry from *@pos, which starts at 0. Returns NULL and
+    resets *@pos at the end.
+
+void free##name(name* map);
+    Free the table, @allocator is kept.
+
+*/
+
+static inline u64 hashU64(u64 x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    return x ^ (x >> 33);
+}
+
+#define DEFINE_MAP(name, K, V, hash, eq)                                                    \
+    typedef struct {                                                                        \
+        K key;                                                                              \
+        V value;                                                                            \
+        bool used;                                                                          \
+    } name##Entry;                                                                          \
+                                                                                            \
+    typedef struct {                                                                        \
+        name##Entry* items;                                                                 \
+        usize cap;                                                                          \
+        usize len;                                                                          \
+        Allocator* allocator;                                                               \
+    } name;                                                                                 \
+                                                                                            \
+    /* The entry of @key, or the empty one where it would go. */                            \
+    static inline name##Entry* find##name##Entry(name* map, K key)                          \
+    {                                                                                       \
+        usize mask = map->cap - 1;                                                          \
+        for (usize idx = (usize)hash(key) & mask;; idx = (idx + 1) & mask) {                \
+            name##Entry* entry = &map->items[idx];                                          \
+            if (!entry->used || eq(entry->key, key)) return entry;                          \
+        }                                                                                   \
+    }                                                                                       \
+                                                                                            \
+    static inline void grow##name(name* map, usize cap)                                     \
+    {                                                                                       \
+        name newer = { .cap = cap, .len = map->len, .allocator = map->allocator };          \
+        newer.items = allocWith(map->allocator, cap * sizeof *newer.items);                 \
+        miscAssert(newer.items != NULL, "grow" #name "() failed");                          \
+        memset(newer.items, 0, cap * sizeof *newer.items);                                  \
+                                                                                            \
+        for (usize i = 0; i < map->cap; i++) {                                              \
+            if (map->items[i].used)                                                         \
+                *find##name##Entry(&newer, map->items[i].key) = map->items[i];              \
+        }                                                                                   \
+        freeWith(map->allocator, map->items);                                               \
+        *map = newer;                                                                       \
+    }                                                                                       \
+                                                                                            \
+    static inline void putIn##name(name* map, K key, V value)                               \
+    {                                                                                       \
+        if (map->cap == 0)                                                                  \
+            grow##name(map, MISC_MAP_MINIMUM);                                              \
+        else if ((f64)map->len >= (f64)map->cap * MISC_MAP_LOADF)                           \
+            grow##name(map, map->cap * 2);                                                  \
+                                                                                            \
+        name##Entry* entry = find##name##Entry(map, key);                                   \
+        if (!entry->used) {                                                                 \
+            entry->used = true;                                                             \
+            entry->key = key;                                                               \
+            map->len++;                                                                     \
+        }                                                                                   \
+        entry->value = value;                                                               \
+    }                                                                                       \
+                                                                                            \
+    static inline V* getFrom##name(name* map, K key)                                        \
+    {                                                                                       \
+        if (map->len == 0) return NULL;                                                     \
+        name##Entry* entry = find##name##Entry(map, key);                                   \
+        return entry->used ? &entry->value : NULL;                                          \
+    }                                                                                       \
+                                                                                            \
+    static inline bool deleteFrom##name(name* map, K key)                                   \
+    {                                                                                       \
+        if (map->len == 0) return false;                                                    \
+        name##Entry* entry = find##name##Entry(map, key);                                   \
+        if (!entry->used) return false;                                                     \
+                                                                                            \
+        /* A later key moves into the hole unless its home is past the hole. */             \
+        usize mask = map->cap - 1, hole = (usize)(entry - map->items);                      \
+        for (usize idx = (hole + 1) & mask; map->items[idx].used; idx = (idx + 1) & mask) { \
+            usize home = (usize)hash(map->items[idx].key) & mask;                           \
+            if (((idx - home) & mask) >= ((idx - hole) & mask)) {                           \
+                map->items[hole] = map->items[idx];                                         \
+                hole = idx;                                                                 \
+            }                                                                               \
+        }                                                                                   \
+        map->items[hole].used = false;                                                      \
+        map->len--;                                                                         \
+        return true;                                                                        \
+    }                                                                                       \
+                                                                                            \
+    static inline name##Entry* iterate##name(name* map, usize* pos)                         \
+    {                                                                                       \
+        for (; *pos < map->cap; (*pos)++) {                                                 \
+            if (map->items[*pos].used) return &map->items[(*pos)++];                        \
+        }                                                                                   \
+        *pos = 0;                                                                           \
+        return NULL;                                                                        \
+    }                                                                                       \
+                                                                                            \
+    static inline void free##name(name* map)                                                \
+    {                                                                                       \
+        Allocator* allocator = map->allocator;                                              \
+        freeWith(allocator, map->items);                                                    \
+        memset(map, 0, sizeof *map);                                                        \
+        map->allocator = allocator;                                                         \
+    }
+
+/*
+
 Ring buffer, Circular buffer, Cyclic buffer.
 This is a wrapper around fixed-size buffer that let you
 read/write at a specific position without worried about
@@ -25,9 +25,12 @@ library.
 #endif
 
 #define CFLAGS "-Wall", "-Werror", "-Wextra", "-pedantic", "-std=c99", "-ggdb", "-O0" //"-O3", "-ffast-math", "-flto", "-s"
+#define BENCH_CFLAGS "-Wall", "-Werror", "-Wextra", "-pedantic", "-std=c99", "-O2", "-march=native"
 
 void compileExample(Nob_Cmd* cmd, Nob_Procs* procs, char* input, char* output);
 void compileAllExample(Nob_Cmd* cmd, Nob_Procs* procs);
+void compileBench(Nob_Cmd* cmd, Nob_Procs* procs, char* input, char* output);
+void compileAllBench(Nob_Cmd* cmd, Nob_Procs* procs);
 
 int main(int argc, char** argv)
 {
@@ -37,6 +40,7 @@ int main(int argc, char** argv)
     Nob_Procs procs = {0};
 
     compileAllExample(&cmd, &procs);
+    compileAllBench(&cmd, &procs);
     if (!nob_procs_wait_and_reset(&procs)) {
         return 1;
     }
@@ -66,4 +70,38 @@ void compileAllExample(Nob_Cmd* cmd, Nob_Procs* procs)
     compileExample(cmd, procs, "examples/map.c", "build/examples/map");
     compileExample(cmd, procs, "examples/string.c", "build/examples/string");
     compileExample(cmd, procs, "examples/ringbuf.c", "build/examples/ringbuf");
+    compileExample(cmd, procs, "examples/pool.c", "build/examples/pool");
+    compileExample(cmd, procs, "examples/soa.c", "build/examples/soa");
+    compileExample(cmd, procs, "examples/stream.c", "build/examples/stream");
+    compileExample(cmd, procs, "examples/number.c", "build/examples/number");
+}
+
+void compileBench(
+    Nob_Cmd*   cmd,
+    Nob_Procs* procs,
+    char*      input,
+    char*      output)
+{
+    nob_cmd_append(cmd, CC, BENCH_CFLAGS);
+    nob_cc_inputs(cmd, input);
+    nob_cc_output(cmd, output);
+    nob_cmd_append(cmd, "-lpthread");
+    nob_da_append(procs, nob_cmd_run_async_and_reset(cmd));
+}
+
+void compileAllBench(Nob_Cmd* cmd, Nob_Procs* procs)
+{
+    nob_mkdir_if_not_exists("build");
+    nob_mkdir_if_not_exists("build/bench");
+
+    compileBench(cmd, procs, "bench/arena_threads.c", "build/bench/arena_threads");
+    compileBench(cmd, procs, "bench/array_append.c", "build/bench/array_append");
+    compileBench(cmd, procs, "bench/sort.c", "build/bench/sort");
+    compileBench(cmd, procs, "bench/search.c", "build/bench/search");
+    compileBench(cmd, procs, "bench/utf8.c", "build/bench/utf8");
+    compileBench(cmd, procs, "bench/hash.c", "build/bench/hash");
+    compileBench(cmd, procs, "bench/map_storage.c", "build/bench/map_storage");
+    compileBench(cmd, procs, "bench/map_layout.c", "build/bench/map_layout");
+    compileBench(cmd, procs, "bench/map_churn.c", "build/bench/map_churn");
+    compileBench(cmd, procs, "bench/map_typed.c", "build/bench/map_typed");
 }